@@ -1,9 +1,40 @@
 tool 'tools-gfx' {
+   lib 'tools-gfx' {
+      limp_src 'src-tools-gfx/*.hpp',
+      src 'src-tools-gfx/*.cpp',
+      link_project {
+         'core',
+         'core-id-with-names',
+         'util',
+         'util-fs',
+         'util-string',
+         'cli',
+         'gfx-tex',
+         'gfx'
+      }
+   },
    app 'atex' {
       icon 'icon/bengine-warm.ico',
       limp_src 'src-atex/*.hpp',
       src 'src-atex/*.cpp',
       link_project {
+         'tools-gfx',
+         'core',
+         'core-id-with-names',
+         'util',
+         'util-fs',
+         'util-string',
+         'cli',
+         'gfx-tex',
+         'gfx'
+      }
+   },
+   app 'atex-bench' {
+      icon 'icon/bengine-warm.ico',
+      limp_src 'src-atex-bench/*.hpp',
+      src 'src-atex-bench/*.cpp',
+      link_project {
+         'tools-gfx',
          'core',
          'core-id-with-names',
          'util',
@@ -19,6 +50,7 @@ tool 'tools-gfx' {
       limp_src 'src-concur/*.hpp',
       src 'src-concur/*.cpp',
       link_project {
+         'tools-gfx',
          'core',
          'core-id-with-names',
          'util',
@@ -26,6 +58,7 @@ tool 'tools-gfx' {
          'util-string',
          'cli',
          'ctable',
+         'gfx-tex',
          'gfx'
       }
    }
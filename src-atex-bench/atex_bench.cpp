@@ -0,0 +1,7 @@
+#include "bench_app.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+   be::atex::bench::BenchApp app(argc, argv);
+   return app();
+}
@@ -0,0 +1,194 @@
+#include "bench_app.hpp"
+#include "../src-tools-gfx/exception_logging.hpp"
+#include <be/core/log_exception.hpp>
+#include <be/core/logging.hpp>
+#include <be/cli/cli.hpp>
+#include <be/util/paths.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+namespace be::atex::bench {
+
+///////////////////////////////////////////////////////////////////////////////
+BenchApp::BenchApp(int argc, char** argv) {
+   init_.emplace();
+   default_log().verbosity_mask(v::info_or_worse);
+   try {
+      using namespace cli;
+      using namespace color;
+      using namespace ct;
+      Processor proc;
+
+      bool show_help = false;
+      bool verbose = false;
+      S help_query;
+
+      proc
+         (prologue (Table() << header << "ATEX BENCHMARKS").query())
+
+         (synopsis (Cell() << fg_dark_gray << "[ " << fg_cyan << "OPTIONS" << fg_dark_gray << " ] [ " << fg_cyan << "CASE" << fg_dark_gray << " ... ]"))
+
+         (abstract ("Times the gfx-tex readers, writers, and pixel conversions used by atex on synthetic textures."))
+
+         (summary (Cell() << "Every input is generated from a fixed seed, so results can be compared between builds.  If any " << fg_cyan << "CASE"
+                          << reset << " arguments are given, only benchmarks whose names contain one of them are run."))
+
+         (any ([&](const S& str) {
+               filters_.push_back(str);
+               return true;
+            }))
+
+         (numeric_param<I32> ({ "s" }, { "size" }, "N", config_.dim, 16, 16384)
+            .desc("Specifies the width and height of the synthetic images.")
+            .extra("Merge benchmarks use layers half this size.  Defaults to 1024."))
+
+         (numeric_param<U16> ({ "l" }, { "layers" }, "N", config_.layers, 1, 2048)
+            .desc("Specifies the number of layers to merge in merge benchmarks.")
+            .extra("Defaults to 16."))
+
+         (numeric_param<U16> ({ "n" }, { "iterations" }, "N", iterations_, 1, 10000)
+            .desc("Specifies the number of timed iterations of each benchmark.")
+            .extra("Each benchmark also runs once untimed before the first iteration.  Defaults to 5."))
+
+         (param ({ "d" }, { "work-dir" }, "PATH", [&](const S& str) {
+               config_.work_dir = util::parse_path(str);
+            }).desc("Specifies a directory in which to write temporary files.")
+              .extra("Defaults to an 'atex-bench' directory in the system temporary directory."))
+
+         (flag ({ }, { "list" }, list_only_)
+            .desc("Lists the names of the selected benchmarks without running them."))
+
+         (verbosity_param ({ "v" },{ "verbosity" }, "LEVEL", default_log().verbosity_mask()))
+
+         (param ({ "?" },{ "help" }, "OPTION",
+            [&](const S& value) {
+               show_help = true;
+               help_query = value;
+            }).default_value(S())
+              .allow_options_as_values(true)
+              .desc(Cell() << "Outputs this help message.  For more verbose help, use " << fg_yellow << "--help")
+              .extra(Cell() << nl << "If " << fg_cyan << "OPTION" << reset
+                            << " is provided, the options list will be filtered to show only options that contain that string."))
+
+         (flag ({ },{ "help" }, verbose).ignore_values(true))
+
+         (exit_code (status_ok, "Every selected benchmark ran successfully."))
+         (exit_code (status_exception, "An unexpected error occurred."))
+         (exit_code (status_cli_error, "There was a problem parsing the command line arguments."))
+         (exit_code (status_no_cases, "No benchmarks matched the specified names."))
+         (exit_code (status_case_error, "At least one benchmark failed."))
+         ;
+
+      proc.process(argc, argv);
+
+      if (show_help) {
+         proc.describe(std::cout, verbose, help_query);
+         list_only_ = true;
+      }
+
+      if (config_.work_dir.empty()) {
+         config_.work_dir = fs::temp_directory_path() / "atex-bench";
+      }
+
+   } catch (...) {
+      set_status_(status_cli_error);
+      tools::log_current_exception();
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int BenchApp::operator()() {
+   if (status_ != 0) {
+      return status_;
+   }
+
+   try {
+      std::vector<BenchCase> cases = make_bench_cases(config_);
+      if (!filters_.empty()) {
+         cases.erase(std::remove_if(cases.begin(), cases.end(), [this](const BenchCase& bench) {
+               return std::none_of(filters_.begin(), filters_.end(), [&](const S& filter) {
+                  return bench.name.find(filter) != S::npos;
+               });
+            }), cases.end());
+      }
+
+      if (cases.empty()) {
+         set_status_(status_no_cases);
+         return status_;
+      }
+
+      if (list_only_) {
+         for (const BenchCase& bench : cases) {
+            std::cout << bench.name << std::endl;
+         }
+         return status_;
+      }
+
+      fs::create_directories(config_.work_dir);
+
+      std::cout << std::left << std::setw(36) << "benchmark"
+                << std::right << std::setw(12) << "min ms"
+                << std::setw(12) << "median ms"
+                << std::setw(12) << "MB/s" << std::endl;
+
+      for (const BenchCase& bench : cases) {
+         run_case_(bench);
+      }
+
+   } catch (...) {
+      set_status_(status_exception);
+      tools::log_current_exception();
+   }
+
+   return status_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BenchApp::set_status_(status_code_ status) {
+   if (status > status_) {
+      status_ = static_cast<U8>(status);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BenchApp::run_case_(const BenchCase& bench) {
+   using clock = std::chrono::steady_clock;
+
+   std::vector<double> times;
+   U64 bytes = 0;
+   try {
+      if (bench.setup) {
+         bench.setup();
+      }
+      bench.run();
+
+      times.reserve(iterations_);
+      for (U16 i = 0; i < iterations_; ++i) {
+         const clock::time_point start = clock::now();
+         bytes = bench.run();
+         times.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+      }
+   } catch (const std::exception& e) {
+      set_status_(status_case_error);
+      be_error() << "Benchmark failed!"
+         & attr("Benchmark") << bench.name
+         | default_log();
+      log_exception(e);
+      return;
+   }
+
+   std::sort(times.begin(), times.end());
+   const double min = times.front();
+   const double median = times.size() % 2 == 0 ? (times[times.size() / 2 - 1] + times[times.size() / 2]) * 0.5 : times[times.size() / 2];
+   const double mb_per_s = median > 0 ? double(bytes) / (1024.0 * 1024.0) / (median / 1000.0) : 0.0;
+
+   std::cout << std::left << std::setw(36) << bench.name
+             << std::right << std::fixed << std::setprecision(3)
+             << std::setw(12) << min
+             << std::setw(12) << median
+             << std::setprecision(1) << std::setw(12) << mb_per_s << std::endl;
+}
+
+} // be::atex::bench
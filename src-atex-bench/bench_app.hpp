@@ -0,0 +1,41 @@
+#pragma once
+#ifndef BE_ATEX_BENCH_BENCH_APP_HPP_
+#define BE_ATEX_BENCH_BENCH_APP_HPP_
+
+#include "bench_cases.hpp"
+#include <be/core/lifecycle.hpp>
+#include <optional>
+
+namespace be::atex::bench {
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchApp final {
+public:
+   BenchApp(int argc, char** argv);
+
+   int operator()();
+
+private:
+   enum status_code_ : U8 {
+      status_ok = 0,
+      status_exception,
+      status_cli_error,
+      status_no_cases,
+      status_case_error
+   };
+
+   void set_status_(status_code_ status);
+   void run_case_(const BenchCase& bench);
+
+   std::optional<CoreInitLifecycle> init_;
+   I8 status_ = 0;
+
+   BenchConfig config_;
+   std::vector<S> filters_;
+   U16 iterations_ = 5;
+   bool list_only_ = false;
+};
+
+} // be::atex::bench
+
+#endif
@@ -0,0 +1,384 @@
+#include "bench_cases.hpp"
+#include <be/gfx/tex/betx_writer.hpp>
+#include <be/gfx/tex/blit_pixels.hpp>
+#include <be/gfx/tex/bmp_writer.hpp>
+#include <be/gfx/tex/hdr_writer.hpp>
+#include <be/gfx/tex/jpeg_writer.hpp>
+#include <be/gfx/tex/ktx_writer.hpp>
+#include <be/gfx/tex/png_writer.hpp>
+#include <be/gfx/tex/texture_reader.hpp>
+#include <be/gfx/tex/tga_writer.hpp>
+#include <memory>
+
+namespace be::atex::bench {
+namespace {
+
+using namespace gfx::tex;
+
+constexpr U32 seed = 0x5eed1234u;
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat make_format(BlockPacking packing, U8 block_size, FieldType type, Colorspace colorspace, ImageFormat::swizzles_type swizzles) {
+   ImageFormat format;
+   format.packing(packing);
+   format.block_dim(ImageFormat::block_dim_type(1));
+   format.block_size(block_size);
+   format.components(4);
+   format.field_types(ImageFormat::field_types_type(type));
+   format.swizzles(swizzles);
+   format.colorspace(colorspace);
+   format.premultiplied(false);
+   return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgba8_srgb() {
+   return make_format(BlockPacking::s_8_8_8_8, 4, FieldType::unorm, Colorspace::srgb, swizzles_rgba());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat bgra8_srgb() {
+   return make_format(BlockPacking::s_8_8_8_8, 4, FieldType::unorm, Colorspace::srgb,
+                      ImageFormat::swizzles_type(Swizzle::field_two, Swizzle::field_one, Swizzle::field_zero, Swizzle::field_three));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgb8_srgb() {
+   ImageFormat format = make_format(BlockPacking::s_8_8_8, 3, FieldType::unorm, Colorspace::srgb,
+                                    ImageFormat::swizzles_type(Swizzle::field_zero, Swizzle::field_one, Swizzle::field_two, Swizzle::one));
+   format.components(3);
+   return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat r8_linear() {
+   ImageFormat format = make_format(BlockPacking::s_8, 1, FieldType::unorm, Colorspace::linear_other,
+                                    ImageFormat::swizzles_type(Swizzle::field_zero, Swizzle::field_zero, Swizzle::field_zero, Swizzle::one));
+   format.components(1);
+   return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgba16_linear() {
+   return make_format(BlockPacking::s_16_16_16_16, 8, FieldType::unorm, Colorspace::linear_other, swizzles_rgba());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgba16f_linear() {
+   return make_format(BlockPacking::s_16_16_16_16, 8, FieldType::sfloat, Colorspace::linear_other, swizzles_rgba());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgba32f_linear() {
+   return make_format(BlockPacking::s_32_32_32_32, 16, FieldType::sfloat, Colorspace::linear_other, swizzles_rgba());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct synthetic_ {
+   std::unique_ptr<TextureStorage> storage;
+   TextureView view;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+synthetic_ allocate(const ImageFormat& format, ivec3 dim, std::size_t layers) {
+   synthetic_ result;
+   result.storage = std::make_unique<TextureStorage>(layers, 1, 1, dim, format.block_dim(), format.block_size(), TextureAlignment());
+   result.view = TextureView(format, layers > 1 ? TextureClass::planar_array : TextureClass::planar, *result.storage, 0, layers, 0, 1, 0, 1);
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Smooth gradients with a little noise, so that the encoders see something
+// closer to real content than either pure noise or flat color.
+synthetic_ make_rgba8(ivec3 dim, std::size_t layers, U32 state) {
+   synthetic_ result = allocate(rgba8_srgb(), dim, layers);
+   for (std::size_t layer = 0; layer < layers; ++layer) {
+      ImageView img = result.view.image(layer, 0, 0);
+      for (I32 y = 0; y < dim.y; ++y) {
+         UC* line = img.data() + y * img.line_span();
+         for (I32 x = 0; x < dim.x; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const U32 noise = state & 0xF;
+            UC* texel = line + x * 4;
+            texel[0] = UC((x * 255 / std::max(1, dim.x - 1) + noise) & 0xFF);
+            texel[1] = UC((y * 255 / std::max(1, dim.y - 1) + noise) & 0xFF);
+            texel[2] = UC(((x + y + I32(layer) * 16) * 2 + noise) & 0xFF);
+            texel[3] = UC(0xFF - ((x ^ y) & 0x3F));
+         }
+      }
+   }
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void blit_layer(const ConstTextureView& src, std::size_t src_layer, const TextureView& dest, std::size_t dest_layer) {
+   ConstImageView src_img = src.image(src_layer, 0, 0);
+   ImageView dest_img = dest.image(dest_layer, 0, 0);
+   const ImageRegion region(ibox { ivec3(0), glm::min(src_img.dim(), dest_img.dim()) });
+   blit_pixels(src_img, region, dest_img, region);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+synthetic_ convert(const synthetic_& src, const ImageFormat& format) {
+   synthetic_ result = allocate(format, src.view.image().dim(), src.view.layers());
+   for (std::size_t layer = 0; layer < src.view.layers(); ++layer) {
+      blit_layer(src.view, layer, result.view, layer);
+   }
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+U64 image_bytes(const ConstTextureView& view) {
+   U64 bytes = 0;
+   for (std::size_t layer = 0; layer < view.layers(); ++layer) {
+      bytes += view.image(layer, 0, 0).size();
+   }
+   return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void check(const std::error_code& ec, const Path& path) {
+   if (ec) {
+      throw fs::filesystem_error("Benchmark I/O failed", path, ec);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+enum class writer_kind_ : U8 {
+   png = 0,
+   tga,
+   tga_rle,
+   bmp,
+   hdr,
+   jpeg,
+   betx,
+   betx_zlib,
+   ktx
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void write_file(writer_kind_ kind, const ConstTextureView& view, const Path& path, int jpeg_quality) {
+   std::error_code ec;
+   switch (kind) {
+      case writer_kind_::png:
+      {
+         PngWriter writer;
+         writer.image(view.image());
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::tga:
+      case writer_kind_::tga_rle:
+      {
+         TgaWriter writer;
+         writer.image(view.image());
+         writer.use_rle(kind == writer_kind_::tga_rle);
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::bmp:
+      {
+         BmpWriter writer;
+         writer.image(view.image());
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::hdr:
+      {
+         HdrWriter writer;
+         writer.image(view.image());
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::jpeg:
+      {
+         JpegWriter writer;
+         writer.image(view.image());
+         writer.quality(jpeg_quality);
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::betx:
+      case writer_kind_::betx_zlib:
+      {
+         BetxWriter writer;
+         writer.payload_compression(kind == writer_kind_::betx_zlib ? BetxWriter::PayloadCompressionMode::zlib : BetxWriter::PayloadCompressionMode::none);
+         writer.texture(view);
+         writer.write(path, ec);
+         break;
+      }
+      case writer_kind_::ktx:
+      {
+         KtxWriter writer;
+         writer.texture(view);
+         writer.write(path, ec);
+         break;
+      }
+   }
+   check(ec, path);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct file_case_ {
+   const char* name;
+   writer_kind_ kind;
+   const char* extension;
+   int jpeg_quality;
+   bool float_source;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+const file_case_ file_cases[] = {
+   { "png",       writer_kind_::png,       "png",  0,  false },
+   { "tga",       writer_kind_::tga,       "tga",  0,  false },
+   { "tga-rle",   writer_kind_::tga_rle,   "tga",  0,  false },
+   { "bmp",       writer_kind_::bmp,       "bmp",  0,  false },
+   { "hdr",       writer_kind_::hdr,       "hdr",  0,  true },
+   { "jpeg-q50",  writer_kind_::jpeg,      "jpg",  50, false },
+   { "jpeg-q70",  writer_kind_::jpeg,      "jpg",  70, false },
+   { "jpeg-q90",  writer_kind_::jpeg,      "jpg",  90, false },
+   { "betx",      writer_kind_::betx,      "betx", 0,  false },
+   { "betx-zlib", writer_kind_::betx_zlib, "betx", 0,  false },
+   { "ktx",       writer_kind_::ktx,       "ktx",  0,  false },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct blit_case_ {
+   const char* name;
+   ImageFormat (*src)();
+   ImageFormat (*dest)();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+const blit_case_ blit_cases[] = {
+   { "rgba8-srgb>rgba8-srgb",      rgba8_srgb,     rgba8_srgb },
+   { "rgba8-srgb>bgra8-srgb",      rgba8_srgb,     bgra8_srgb },
+   { "rgba8-srgb>rgb8-srgb",       rgba8_srgb,     rgb8_srgb },
+   { "r8-linear>rgba8-srgb",       r8_linear,      rgba8_srgb },
+   { "rgba8-srgb>rgba32f-linear",  rgba8_srgb,     rgba32f_linear },
+   { "rgba32f-linear>rgba8-srgb",  rgba32f_linear, rgba8_srgb },
+   { "rgba16f-linear>rgba32f",     rgba16f_linear, rgba32f_linear },
+   { "rgba16-linear>rgba8-srgb",   rgba16_linear,  rgba8_srgb },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void add_blit_cases(const BenchConfig& config, std::vector<BenchCase>& cases) {
+   auto base = std::make_shared<synthetic_>();
+   const ivec3 dim = ivec3(config.dim, config.dim, 1);
+
+   for (const blit_case_& c : blit_cases) {
+      auto src = std::make_shared<synthetic_>();
+      auto dest = std::make_shared<synthetic_>();
+      BenchCase bench;
+      bench.name = S("blit/") + c.name;
+      bench.setup = [=]() {
+         if (!base->view) {
+            *base = make_rgba8(dim, 1, seed);
+         }
+         *src = convert(*base, c.src());
+         *dest = allocate(c.dest(), dim, 1);
+      };
+      bench.run = [=]() {
+         blit_layer(src->view, 0, dest->view, 0);
+         return image_bytes(dest->view);
+      };
+      cases.push_back(std::move(bench));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Merges one single-layer texture per layer into a new array texture, the way
+// atex does when assembling separate input files.
+void add_merge_cases(const BenchConfig& config, std::vector<BenchCase>& cases) {
+   const ivec3 dim = ivec3(std::max(1, config.dim / 2), std::max(1, config.dim / 2), 1);
+   const std::size_t layers = config.layers;
+   auto inputs = std::make_shared<std::vector<synthetic_>>();
+
+   auto setup = [=]() {
+      if (inputs->empty()) {
+         for (std::size_t layer = 0; layer < layers; ++layer) {
+            inputs->push_back(make_rgba8(dim, 1, seed + U32(layer)));
+         }
+      }
+   };
+
+   for (ImageFormat (*format)() : { rgba8_srgb, rgba32f_linear }) {
+      BenchCase bench;
+      bench.name = S("merge/") + std::to_string(layers) + "-layers" + (format == rgba8_srgb ? "" : "-rgba32f");
+      bench.setup = setup;
+      bench.run = [=]() {
+         synthetic_ merged = allocate(format(), dim, layers);
+         for (std::size_t layer = 0; layer < layers; ++layer) {
+            blit_layer((*inputs)[layer].view, 0, merged.view, layer);
+         }
+         return image_bytes(merged.view);
+      };
+      cases.push_back(std::move(bench));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void add_file_cases(const BenchConfig& config, std::vector<BenchCase>& cases) {
+   const ivec3 dim = ivec3(config.dim, config.dim, 1);
+   auto rgba8 = std::make_shared<synthetic_>();
+   auto rgba32f = std::make_shared<synthetic_>();
+
+   auto source = [=](bool float_source) -> const synthetic_& {
+      if (!rgba8->view) {
+         *rgba8 = make_rgba8(dim, 1, seed);
+      }
+      if (float_source) {
+         if (!rgba32f->view) {
+            *rgba32f = convert(*rgba8, rgba32f_linear());
+         }
+         return *rgba32f;
+      }
+      return *rgba8;
+   };
+
+   for (const file_case_& c : file_cases) {
+      const Path write_path = config.work_dir / (S("write-") + c.name + "." + c.extension);
+      const Path read_path = config.work_dir / (S("read-") + c.name + "." + c.extension);
+
+      BenchCase write;
+      write.name = S("write/") + c.name;
+      write.setup = [=]() { source(c.float_source); };
+      write.run = [=]() {
+         const synthetic_& src = source(c.float_source);
+         write_file(c.kind, src.view, write_path, c.jpeg_quality);
+         return image_bytes(src.view);
+      };
+      cases.push_back(std::move(write));
+
+      BenchCase read;
+      read.name = S("read/") + c.name;
+      read.setup = [=]() {
+         write_file(c.kind, source(c.float_source).view, read_path, c.jpeg_quality);
+      };
+      read.run = [=]() {
+         std::error_code ec;
+         TextureReader reader;
+         reader.read(read_path, ec);
+         check(ec, read_path);
+         Texture tex = reader.texture(ec);
+         check(ec, read_path);
+         return image_bytes(tex.view);
+      };
+      cases.push_back(std::move(read));
+   }
+}
+
+} // be::atex::bench::()
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<BenchCase> make_bench_cases(const BenchConfig& config) {
+   std::vector<BenchCase> cases;
+   add_file_cases(config, cases);
+   add_blit_cases(config, cases);
+   add_merge_cases(config, cases);
+   return cases;
+}
+
+} // be::atex::bench
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef BE_ATEX_BENCH_BENCH_CASES_HPP_
+#define BE_ATEX_BENCH_BENCH_CASES_HPP_
+
+#include <be/core/filesystem.hpp>
+#include <functional>
+#include <vector>
+
+namespace be::atex::bench {
+
+///////////////////////////////////////////////////////////////////////////////
+struct BenchConfig {
+   I32 dim = 1024;
+   U16 layers = 16;
+   Path work_dir;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One timed operation.
+///
+/// \details setup is run once before any iterations and is not timed.  run
+///         is called once per iteration and returns the number of bytes it
+///         processed, which is used to report throughput.
+struct BenchCase {
+   S name;
+   std::function<void()> setup;
+   std::function<U64()> run;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds every benchmark case.
+///
+/// \details Inputs are synthetic and generated from a fixed seed, so results
+///         are comparable between runs and between versions of gfx-tex.
+///         Cases which read or write files use config.work_dir.
+std::vector<BenchCase> make_bench_cases(const BenchConfig& config);
+
+} // be::atex::bench
+
+#endif
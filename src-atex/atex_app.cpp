@@ -5,8 +5,6 @@
 #include <be/util/path_glob.hpp>
 #include <be/util/parse_numeric_string.hpp>
 #include <be/gfx/tex/visit_texture.hpp>
-#include <be/gfx/tex/texture_reader.hpp>
-#include <be/gfx/tex/duplicate_texture.hpp>
 #include <be/gfx/tex/log_texture_info.hpp>
 #include <be/gfx/tex/mipmapping.hpp>
 #include <be/gfx/tex/blit_pixels.hpp>
@@ -17,7 +15,12 @@
 #include <be/gfx/tex/jpeg_writer.hpp>
 #include <be/gfx/tex/png_writer.hpp>
 #include <be/gfx/tex/tga_writer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <map>
+#include <unordered_map>
 
 namespace be::atex {
 
@@ -25,6 +28,20 @@ using namespace be::gfx::tex;
 
 ///////////////////////////////////////////////////////////////////////////////
 int AtexApp::operator()() {
+   if (!batch_path_.empty()) {
+      if (status_ == 0) {
+         run_batch_();
+      }
+      return status_;
+   }
+
+   if (!serve_path_.empty()) {
+      if (status_ == 0) {
+         run_serve_();
+      }
+      return status_;
+   }
+
    if (output_files_.empty()) {
       set_status_(status_no_output);
    }
@@ -37,49 +54,111 @@ int AtexApp::operator()() {
       return status_;
    }
 
+   if (profile_ || !stats_json_path_.empty()) {
+      profiler_ = std::make_unique<Profiler>();
+   }
+
    try {
-      if (input_search_paths_.empty()) {
-         input_search_paths_.push_back(util::cwd());
-      }
+      run_();
+   } catch (...) {
+      set_status_(status_exception);
+      log_current_exception();
+   }
+
+   if (profiler_) {
+      report_profile_();
+   }
 
-      if (output_path_base_.empty()) {
-         output_path_base_ = util::cwd();
+   return status_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::run_() {
+   if (input_search_paths_.empty()) {
+      input_search_paths_.push_back(util::cwd());
+   }
+
+   if (output_path_base_.empty()) {
+      output_path_base_ = util::cwd();
+   }
+
+   if (!pool_) {
+      init_pool_();
+   }
+
+   std::vector<input_file_> files = find_inputs_();
+   if (files.empty()) {
+      set_status_(status_no_input);
+      return;
+   }
+
+   if (probe_) {
+      run_probe_(files);
+      return;
+   }
+
+   U64 cache_key = 0;
+   if (!cache_path_.empty()) {
+      cache_key = cache_key_(files);
+      if (restore_cached_outputs_(cache_key)) {
+         return;
       }
+   }
 
-      std::vector<input_> inputs = load_inputs_();
-      if (inputs.empty()) {
+   std::vector<Path> written;
+   if (stream_inputs_) {
+      written = stream_outputs_(files);
+   } else {
+      merge_plan_ plan;
+      std::vector<input_> inputs = load_inputs_(files, plan);
+      if (inputs.empty() || !plan_layout_(plan, inputs)) {
          set_status_(status_no_input);
-         return status_;
+         return;
+      }
+
+      // Outputs are planned first, so that only the images they need are converted.
+      std::vector<output_job_> jobs = plan_outputs_(plan);
+      if (jobs.empty()) {
+         return;
       }
+      prune_plan_(plan, jobs);
 
-      Texture tex = make_texture_(inputs);
+      plan_format_(plan, inputs[plan.base_input].texture.view, jobs);
+      Texture tex = make_texture_(inputs, plan);
       if (!tex.view) {
          set_status_(status_conversion_error);
-         return status_;
+         return;
       }
 
       log_texture_info(tex.view, "Texture Info");
 
-      write_outputs_(tex.view);
+      bind_outputs_(jobs, tex.view);
+      written = write_outputs_(jobs);
+   }
 
-   } catch (const FatalTrace& e) {
-      set_status_(status_exception);
-      log_exception(e);
-   } catch (const RecoverableTrace& e) {
-      set_status_(status_exception);
-      log_exception(e);
-   } catch (const fs::filesystem_error& e) {
-      set_status_(status_exception);
-      log_exception(e);
-   } catch (const std::system_error& e) {
-      set_status_(status_exception);
-      log_exception(e);
-   } catch (const std::exception& e) {
-      set_status_(status_exception);
-      log_exception(e);
+   written_outputs_ = written;
+
+   if (!cache_path_.empty() && status_ <= status_warning) {
+      store_cached_outputs_(cache_key, written);
    }
+}
 
-   return status_;
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::report_profile_() {
+   if (profile_) {
+      profiler_->log_summary();
+   }
+
+   if (!stats_json_path_.empty()) {
+      std::ofstream os(stats_json_path_.string(), std::ios::binary);
+      profiler_->write_json(os);
+      if (!os) {
+         set_status_(status_write_error);
+         be_error() << "Failed to write profile statistics!"
+            & attr(ids::log_attr_path) << stats_json_path_.string()
+            | default_log();
+      }
+   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -90,10 +169,107 @@ void AtexApp::set_status_(status_code_ status) {
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-std::vector<AtexApp::input_> AtexApp::load_inputs_() {
-   std::vector<input_> inputs;
-   std::map<std::size_t, std::size_t> images;
+void AtexApp::init_pool_() {
+   std::size_t threads = jobs_;
+   if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+   }
+   pool_ = std::make_shared<WorkerPool>(threads);
+   io_pool_ = std::make_shared<WorkerPool>(io_depth_);
+}
 
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::init_decode_cache_() {
+   if (decode_cache_mb_ > 0) {
+      decode_cache_ = std::make_shared<DecodeCache>(std::size_t(decode_cache_mb_) << 20);
+   }
+}
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns a single image from a view, where the layer, face, and level are
+// relative to the base of the view, since input views may select a sub-range
+// of their storage.
+template <typename View>
+auto view_image(const View& view, std::size_t layer, std::size_t face, std::size_t level) {
+   View image_view = View(view.format(), view.texture_class(), view.storage(),
+                          view.base_layer() + layer, 1,
+                          view.base_face() + face, 1,
+                          view.base_level() + level, 1);
+   return image_view.image();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool is_byte_identical(const ConstImageView& src, const ImageView& dest) {
+   return src.format() == dest.format() &&
+      src.block_span() == dest.block_span() &&
+      src.dim() == dest.dim();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies an image between two views with identical formats and dimensions.
+// When line and plane alignment also match, it's a single memcpy; otherwise
+// it's done one line at a time.
+void copy_image_bytes(const ConstImageView& src, const ImageView& dest) {
+   if (src.line_span() == dest.line_span() && src.plane_span() == dest.plane_span()) {
+      std::memcpy(dest.data(), src.data(), std::min(src.size(), dest.size()));
+      return;
+   }
+
+   const ImageFormat::block_dim_type block_dim = src.format().block_dim();
+   const ivec3 dim = src.dim();
+   const std::size_t blocks_per_line = (dim.x + block_dim.x - 1) / block_dim.x;
+   const std::size_t lines_per_plane = (dim.y + block_dim.y - 1) / block_dim.y;
+   const std::size_t planes = (dim.z + block_dim.z - 1) / block_dim.z;
+   const std::size_t line_size = blocks_per_line * src.block_span();
+
+   for (std::size_t plane = 0; plane < planes; ++plane) {
+      const UC* src_line = src.data() + plane * src.plane_span();
+      UC* dest_line = dest.data() + plane * dest.plane_span();
+      for (std::size_t line = 0; line < lines_per_plane; ++line) {
+         std::memcpy(dest_line, src_line, line_size);
+         src_line += src.line_span();
+         dest_line += dest.line_span();
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The number of uncompressed bytes an output job writes.
+std::size_t output_bytes(const TextureView& view, I32 depth) {
+   std::size_t bytes = 0;
+   for (std::size_t level = 0; level < view.levels(); ++level) {
+      bytes += view_image(view, 0, 0, level).size() * view.layers() * view.faces();
+   }
+
+   if (depth >= 0) {
+      bytes /= std::max<std::size_t>(1, std::size_t(view.image().dim().z));
+   }
+
+   return bytes;
+}
+
+} // be::atex::()
+
+///////////////////////////////////////////////////////////////////////////////
+// A rough estimate of the time needed to write an output file containing the
+// given number of uncompressed bytes, used to decide which output jobs to
+// start first.
+std::size_t AtexApp::output_cost_(const output_job_& job, std::size_t bytes) {
+   switch (job.file_format) {
+      case TextureFileFormat::betx: return job.payload_compression ? bytes * 16 : bytes;
+      case TextureFileFormat::png:  return bytes * 16 * (1 + std::size_t(job.png_effort) * job.png_effort);
+      case TextureFileFormat::jpeg: return bytes * 4;
+      case TextureFileFormat::tga:  return job.payload_compression ? bytes * 2 : bytes;
+      default:                      return bytes;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<AtexApp::input_file_> AtexApp::find_inputs_() {
+   ProfileScope scope(profiler_.get(), ProfilePhase::glob);
+   std::vector<input_file_> files;
    for (input_file_ file : input_files_) {
       std::vector<Path> paths = util::glob(file.path.string(), input_search_paths_, util::PathMatchType::files_and_misc);
       if (paths.empty()) {
@@ -102,109 +278,225 @@ std::vector<AtexApp::input_> AtexApp::load_inputs_() {
       } else {
          for (const Path& p : paths) {
             file.path = p;
-            input_ input = load_input_(file);
-            if (input.texture.view) {
-               visit_texture_images(input.texture.view, [&](const ImageView& img) {
-
-                  std::size_t layer = input.dest_layer + img.layer();
-                  if (layer >= TextureStorage::max_layers) {
-                     set_status_(status_warning);
-                     be_warn() << "Too many layers; ignoring overflow!"
-                        & attr("Source") << input.path.string()
-                        & attr("Source Layer") << (file.first_layer + img.layer())
-                        & attr("Dest Layer") << layer
-                        | default_log();
-                     return;
-                  }
-
-                  std::size_t face = input.dest_face + img.face();
-                  if (face >= TextureStorage::max_faces) {
-                     set_status_(status_warning);
-                     be_warn() << "Too many faces; ignoring overflow!"
-                        & attr("Source") << input.path.string()
-                        & attr("Source Face") << (file.first_face + img.face())
-                        & attr("Dest Face") << face
-                        | default_log();
-                     return;
-                  }
+            files.push_back(file);
+         }
+      }
+   }
+   return files;
+}
 
-                  std::size_t level = input.dest_level + img.level();
-                  if (level >= TextureStorage::max_levels) {
-                     set_status_(status_warning);
-                     be_warn() << "Too many levels; ignoring overflow!"
-                        & attr("Source") << input.path.string()
-                        & attr("Source Level") << (file.first_level + img.level())
-                        & attr("Dest Level") << level
-                        | default_log();
-                     return;
-                  }
+///////////////////////////////////////////////////////////////////////////////
+std::vector<AtexApp::input_> AtexApp::load_inputs_(const std::vector<input_file_>& files, merge_plan_& plan) {
+   std::vector<input_> inputs;
 
-                  constexpr int layer_bits = 8 * sizeof(TextureStorage::layer_index_type);
-                  constexpr int face_bits = 8 * sizeof(TextureStorage::face_index_type);
-                  constexpr int level_bits = 8 * sizeof(TextureStorage::level_index_type);
-
-                  std::size_t img_id = (layer << (face_bits + level_bits)) | (face << level_bits) | level;
-                  auto result = images.insert(std::make_pair(img_id, inputs.size()));
-                  if (!result.second) {
-                     set_status_(status_warning);
-                     be_warn() << "Replacing an image that was already loaded!"
-                        & attr("Layer") << std::size_t(img.layer())
-                        & attr("Face") << std::size_t(img.face())
-                        & attr("Level") << std::size_t(img.level())
-                        & attr("Old Source") << inputs[result.first->second].path.string()
-                        & attr("New Source") << input.path.string()
-                        | default_log();
-
-                     result.first->second = inputs.size();
-                  }
-               });
+   // Decoding is the expensive part of loading, so it is done on the worker pool.  Everything else, including
+   // logging and resolving collisions between images, happens here in command line order.
+   std::vector<std::future<DecodedTexture>> decoded;
+   decoded.reserve(files.size());
+   for (const input_file_& file : files) {
+      if (file.first_layer <= file.last_layer && file.first_face <= file.last_face && file.first_level <= file.last_level) {
+         decoded.push_back(submit_read_(file));
+      } else {
+         decoded.emplace_back();
+      }
+   }
 
-               inputs.push_back(std::move(input));
-            }
-         }
+   for (std::size_t i = 0; i < files.size(); ++i) {
+      const input_file_& file = files[i];
+      input_ input = load_input_(file, decoded[i]);
+      if (input.texture.view) {
+         add_input_images_(file, input, inputs.size(), inputs, view_layout_(input.texture.view), plan);
+         inputs.push_back(std::move(input));
       }
    }
    return inputs;
 }
 
-namespace {
+///////////////////////////////////////////////////////////////////////////////
+// Called from worker threads; only reads settings which don't change once inputs start loading.
+DecodedTexture AtexApp::read_input_(const input_file_& file) const {
+   if (decode_cache_) {
+      return decode_cache_->read(file.path, file.file_format, profiler_.get());
+   }
+   return read_texture_file(file.path, file.file_format, map_input_files_, profiler_.get());
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-const std::regex& layer_regex() {
-   static std::regex re("-(?:l|layer)(\\d+)", std::regex_constants::icase);
-   return re;
+// Reads a file on the I/O pool, then decodes it on the worker pool once it has arrived, so that reading later inputs
+// overlaps with decoding earlier ones.  Without worker threads, reads are still done ahead on the I/O pool, but each
+// file is decoded by the thread that consumes it, so that no more than -j decodes ever run at once.
+std::future<DecodedTexture> AtexApp::submit_read_(const input_file_& file) {
+   if (map_input_files_ || io_pool_->size() < 2) {
+      return pool_->submit([this, file]() { return read_input_(file); });
+   }
+
+   if (pool_->size() < 2) {
+      auto contents = std::make_shared<std::future<FileContents>>(prefetch_input_(file));
+      return std::async(std::launch::deferred, [this, file, contents]() { return read_prefetched_(file, *contents); });
+   }
+
+   auto promise = std::make_shared<std::promise<DecodedTexture>>();
+   std::future<DecodedTexture> result = promise->get_future();
+   io_pool_->submit([this, file, promise]() {
+      try {
+         DecodedTexture cached;
+         if (decode_cache_ && decode_cache_->find(file.path, file.file_format, cached)) {
+            promise->set_value(std::move(cached));
+            return;
+         }
+
+         auto contents = std::make_shared<FileContents>(read_file_contents(file.path, profiler_.get()));
+         pool_->submit([this, file, promise, contents]() {
+            try {
+               const FileStamp stamp = contents->stamp;
+               DecodedTexture data = decode_file_contents(file.path, file.file_format, std::move(*contents), profiler_.get());
+               if (decode_cache_) {
+                  data = decode_cache_->insert(file.path, file.file_format, stamp, std::move(data));
+               }
+               promise->set_value(std::move(data));
+            } catch (...) {
+               promise->set_exception(std::current_exception());
+            }
+         });
+      } catch (...) {
+         promise->set_exception(std::current_exception());
+      }
+   });
+   return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const std::regex& face_regex() {
-   static std::regex re("-(?:f|face)(\\d+)", std::regex_constants::icase);
-   return re;
+// Starts reading a file ahead of when it's needed, without decoding it.  Returns an invalid future if the file
+// shouldn't be read ahead, in which case read_prefetched_ will read it itself.
+std::future<FileContents> AtexApp::prefetch_input_(const input_file_& file) {
+   if (map_input_files_ || io_pool_->size() < 2 || (decode_cache_ && decode_cache_->contains(file.path, file.file_format))) {
+      return std::future<FileContents>();
+   }
+   return io_pool_->submit([path = file.path, profiler = profiler_.get()]() { return read_file_contents(path, profiler); });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const std::regex& level_regex() {
-   static std::regex re("-(?:m|level)(\\d+)", std::regex_constants::icase);
-   return re;
+DecodedTexture AtexApp::read_prefetched_(const input_file_& file, std::future<FileContents>& contents) {
+   if (!contents.valid()) {
+      return read_input_(file);
+   }
+
+   FileContents data = contents.get();
+   const FileStamp stamp = data.stamp;
+   DecodedTexture result = decode_file_contents(file.path, file.file_format, std::move(data), profiler_.get());
+   if (decode_cache_) {
+      result = decode_cache_->insert(file.path, file.file_format, stamp, std::move(result));
+   }
+   return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const std::regex& depth_regex() {
-   static std::regex re("-(?:z|depth)(\\d+)", std::regex_constants::icase);
-   return re;
+AtexApp::input_layout_ AtexApp::view_layout_(const ConstTextureView& view) {
+   input_layout_ layout;
+   if (view.layers() > 0 && view.faces() > 0) {
+      layout.layers = view.layers();
+      layout.faces = view.faces();
+      layout.levels = view.levels();
+      for (std::size_t level = 0; level < layout.levels; ++level) {
+         layout.level_dims.push_back(view_image(view, 0, 0, level).dim());
+      }
+   }
+   return layout;
 }
 
-} // be::atex::()
+///////////////////////////////////////////////////////////////////////////////
+AtexApp::input_layout_ AtexApp::header_layout_(const input_file_& file, const TextureHeader& header) {
+   auto selected = [](std::size_t count, std::size_t first, std::size_t last) -> std::size_t {
+      return first < count ? std::min(last, count - 1) - first + 1 : 0;
+   };
+
+   input_layout_ layout;
+   layout.layers = selected(header.layers, file.first_layer, file.last_layer);
+   layout.faces = selected(header.faces, file.first_face, file.last_face);
+   layout.levels = selected(header.levels, file.first_level, file.last_level);
+   for (std::size_t level = 0; level < layout.levels; ++level) {
+      layout.level_dims.push_back(mipmap_dim(header.dim, TextureStorage::level_index_type(file.first_level + level)));
+   }
+   return layout;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
+void AtexApp::add_input_images_(const input_file_& file, const input_& input, std::size_t index, const std::vector<input_>& inputs, const input_layout_& layout, merge_plan_& plan) {
+   for (std::size_t src_layer = 0; src_layer < layout.layers; ++src_layer) {
+      std::size_t layer = input.dest_layer + src_layer;
+      if (layer >= TextureStorage::max_layers) {
+         set_status_(status_warning);
+         be_warn() << "Too many layers; ignoring overflow!"
+            & attr("Source") << input.path.string()
+            & attr("Source Layer") << (file.first_layer + src_layer)
+            & attr("Dest Layer") << layer
+            | default_log();
+         continue;
+      }
+
+      for (std::size_t src_face = 0; src_face < layout.faces; ++src_face) {
+         std::size_t face = input.dest_face + src_face;
+         if (face >= TextureStorage::max_faces) {
+            set_status_(status_warning);
+            be_warn() << "Too many faces; ignoring overflow!"
+               & attr("Source") << input.path.string()
+               & attr("Source Face") << (file.first_face + src_face)
+               & attr("Dest Face") << face
+               | default_log();
+            continue;
+         }
+
+         for (std::size_t src_level = 0; src_level < layout.levels; ++src_level) {
+            std::size_t level = input.dest_level + src_level;
+            if (level >= TextureStorage::max_levels) {
+               set_status_(status_warning);
+               be_warn() << "Too many levels; ignoring overflow!"
+                  & attr("Source") << input.path.string()
+                  & attr("Source Level") << (file.first_level + src_level)
+                  & attr("Dest Level") << level
+                  | default_log();
+               continue;
+            }
+
+            image_ref_ ref { index, src_layer, src_face, src_level, layer, face, level, layout.level_dims[src_level] };
+            auto result = plan.images.insert(ImageSlot { layer, face, level }, ref);
+            if (!result.second) {
+               set_status_(status_warning);
+               be_warn() << "Replacing an image that was already loaded!"
+                  & attr("Layer") << src_layer
+                  & attr("Face") << src_face
+                  & attr("Level") << src_level
+                  & attr("Old Source") << inputs[result.first->input].path.string()
+                  & attr("New Source") << input.path.string()
+                  | default_log();
+
+               *result.first = ref;
+            }
+         }
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AtexApp::input_ AtexApp::load_input_(const input_file_& file, std::future<DecodedTexture>& decoded) {
    input_ result;
+
+   be_short_info() << "Loading " << file.file_format << " texture file: " << file.path.string() | default_log();
+
+   if (prepare_input_(file, result)) {
+      apply_decoded_input_(file, decoded.get(), result);
+   }
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool AtexApp::prepare_input_(const input_file_& file, input_& result) {
    result.path = file.path;
    result.dest_layer = file.layer;
    result.dest_face = file.face;
    result.dest_level = file.level;
 
-   be_short_info() << "Loading " << file.file_format << " texture file: " << file.path.string() | default_log();
-
    if (file.first_layer > file.last_layer) {
       set_status_(status_warning);
       be_warn() << "No layers selected!"
@@ -212,7 +504,7 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
          & attr("First Layer") << file.first_layer
          & attr("Last Layer") << file.last_layer
          | default_log();
-      return result;
+      return false;
    }
 
    if (file.first_face > file.last_face) {
@@ -222,7 +514,7 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
          & attr("First Face") << file.first_face
          & attr("Last Face") << file.last_face
          | default_log();
-      return result;
+      return false;
    }
 
    if (file.first_level > file.last_level) {
@@ -232,14 +524,15 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
          & attr("First Level") << file.first_level
          & attr("Last Level") << file.last_level
          | default_log();
-      return result;
+      return false;
    }
 
+   const S filename = file.path.filename().generic_string();
+   const FilenameIndices indices = parse_filename_indices(filename);
+
    if (result.dest_layer == TextureStorage::max_layers) {
-      S filename = file.path.filename().generic_string();
-      std::smatch m;
-      if (std::regex_search(filename, m, layer_regex())) {
-         S index = m[1].str();
+      if (!indices.layer.empty()) {
+         const S index(indices.layer);
          std::error_code ec;
          result.dest_layer = util::parse_bounded_numeric_string<input_file_::layer_index_type>(index, 0, TextureStorage::max_layers - 1, 10, ec);
          if (ec) {
@@ -255,10 +548,8 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
    }
 
    if (result.dest_face == TextureStorage::max_faces) {
-      S filename = file.path.filename().generic_string();
-      std::smatch m;
-      if (std::regex_search(filename, m, face_regex())) {
-         S index = m[1].str();
+      if (!indices.face.empty()) {
+         const S index(indices.face);
          std::error_code ec;
          result.dest_face = util::parse_bounded_numeric_string<input_file_::face_index_type>(index, 0, TextureStorage::max_faces - 1, 10, ec);
          if (ec) {
@@ -274,10 +565,8 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
    }
 
    if (result.dest_level == TextureStorage::max_levels) {
-      S filename = file.path.filename().generic_string();
-      std::smatch m;
-      if (std::regex_search(filename, m, level_regex())) {
-         S index = m[1].str();
+      if (!indices.level.empty()) {
+         const S index(indices.level);
          std::error_code ec;
          result.dest_level = util::parse_bounded_numeric_string<input_file_::level_index_type>(index, 0, TextureStorage::max_levels - 1, 10, ec);
          if (ec) {
@@ -292,28 +581,32 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
       }
    }
 
-   TextureReader reader;
-   if (file.file_format != TextureFileFormat::unknown) {
-      reader.reset(file.file_format);
-   }
+   return true;
+}
 
-   std::error_code ec;
-   reader.read(file.path, ec);
-   if (ec) {
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::apply_decoded_input_(const input_file_& file, DecodedTexture data, input_& result) {
+   result.mapping = std::move(data.mapping);
+   result.contents = std::move(data.contents);
+   result.shared_storage = std::move(data.shared_storage);
+   if (data.cache_hit) {
+      be_short_verbose() << "Using cached decode of " << file.path.string() | default_log();
+   }
+   if (data.read_error) {
       set_status_(status_read_error);
-      log_exception(std::system_error(ec, "Failed to read texture file: " + file.path.string()));
+      log_exception(std::system_error(data.read_error, "Failed to read texture file: " + file.path.string()));
    } else {
-      result.texture = reader.texture(ec);
-      if (ec) {
+      result.texture = std::move(data.texture);
+      if (data.parse_error) {
          set_status_(status_read_error);
-         log_exception(std::system_error(ec, "Failed to parse texture file: " + file.path.string()));
+         log_exception(std::system_error(data.parse_error, "Failed to parse texture file: " + file.path.string()));
       } else if (!result.texture.view) {
          set_status_(status_read_error);
          be_error() << "Loading texture file resulted in an empty texture!"
             & attr(ids::log_attr_path) << file.path.string()
             | default_log();
       } else {
-         result.file_format = reader.format();
+         result.file_format = data.file_format;
          TextureView& view = result.texture.view;
          log_texture_info(view, "Texture Loaded", result.path, result.file_format, v::verbose);
 
@@ -374,71 +667,46 @@ AtexApp::input_ AtexApp::load_input_(const input_file_& file) {
                   be_short_verbose() << "Skipping Levels: [ " << std::size_t(file.last_level + 1) << ", " << std::size_t(view.levels() - 1) << " ]" | default_log();
                }
             }
-
-            try {
-               result.texture = duplicate_texture(new_view);
-            } catch (const std::bad_alloc&) {
-               view = TextureView();
-               set_status_(status_read_error);
-               log_exception(fs::filesystem_error("Not enough memory to duplicate texture", file.path, std::make_error_code(std::errc::not_enough_memory)));
-            }
-         } else {
-            view = new_view;
          }
+
+         // The original storage is kept alive by result.texture; only the view is narrowed, so the skipped images are
+         // never copied.  They are simply not visited when merging.
+         view = new_view;
       }
    }
-
-   return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-Texture AtexApp::make_texture_(const std::vector<input_>& inputs) {
-   Texture result;
-
+bool AtexApp::plan_layout_(merge_plan_& plan, const std::vector<input_>& inputs) {
    be_verbose() << "Merging input textures" | default_log();
 
-   std::map<std::size_t, std::pair<const input_*, ConstImageView>> images;
+   if (plan.images.empty()) {
+      return false;
+   }
+
    TextureStorage::layer_index_type min_layer = TextureStorage::max_layers, max_layer = 0;
    TextureStorage::face_index_type min_face = TextureStorage::max_faces, max_face = 0;
    TextureStorage::level_index_type min_level = TextureStorage::max_levels, max_level = 0;
-   const input_* base_input = nullptr;
-   ivec3 base_dim;
-
-   for (const auto& input : inputs) {
-      ConstTextureView view = input.texture.view;
-      visit_texture_images(view, [&](ConstImageView& img) {
-         std::size_t layer = input.dest_layer + img.layer();
-         std::size_t face = input.dest_face + img.face();
-         std::size_t level = input.dest_level + img.level();
-         if (layer >= TextureStorage::max_layers ||
-             face >= TextureStorage::max_faces ||
-             level >= TextureStorage::max_levels) {
-            return;
-         }
-
-         constexpr int layer_bits = 8 * sizeof(TextureStorage::layer_index_type);
-         constexpr int face_bits = 8 * sizeof(TextureStorage::face_index_type);
-         constexpr int level_bits = 8 * sizeof(TextureStorage::level_index_type);
+   const image_ref_* base = nullptr;
 
-         std::size_t img_id = (layer << (face_bits + level_bits)) | (face << level_bits) | level;
-         images[img_id] = std::make_pair(&input, img);
-
-         if (level < min_level) {
-            base_input = &input;
-            base_dim = img.dim();
-         }
+   for (const image_ref_& ref : plan.images) {
+      if (ref.level < min_level || (ref.level == min_level && ref.input < base->input)) {
+         base = &ref;
+      }
 
-         min_layer = std::min(min_layer, TextureStorage::layer_index_type(layer));
-         max_layer = std::max(max_layer, TextureStorage::layer_index_type(layer));
+      min_layer = std::min(min_layer, TextureStorage::layer_index_type(ref.layer));
+      max_layer = std::max(max_layer, TextureStorage::layer_index_type(ref.layer));
 
-         min_face = std::min(min_face, TextureStorage::face_index_type(face));
-         max_face = std::max(max_face, TextureStorage::face_index_type(face));
+      min_face = std::min(min_face, TextureStorage::face_index_type(ref.face));
+      max_face = std::max(max_face, TextureStorage::face_index_type(ref.face));
 
-         min_level = std::min(min_level, TextureStorage::level_index_type(level));
-         max_level = std::max(max_level, TextureStorage::level_index_type(level));
-      });
+      min_level = std::min(min_level, TextureStorage::level_index_type(ref.level));
+      max_level = std::max(max_level, TextureStorage::level_index_type(ref.level));
    }
 
+   plan.base_input = base->input;
+   plan.base_dim = base->dim;
+
    if (min_layer > 0) {
       set_status_(status_warning);
       be_short_warn() << "Missing layers: [ 0, " << std::size_t(min_layer - 1) << " ]" | default_log();
@@ -452,38 +720,46 @@ Texture AtexApp::make_texture_(const std::vector<input_>& inputs) {
       be_short_warn() << "Missing levels: [ 0, " << std::size_t(min_level - 1) << " ]" | default_log();
 
       for (glm::length_t n = 0; n < 3; ++n) {
-         if (base_dim[n] > 1) {
-            base_dim[n] <<= min_level;
+         if (plan.base_dim[n] > 1) {
+            plan.base_dim[n] <<= min_level;
          }
       }
    }
 
-   TextureStorage::level_index_type expected_levels = mipmap_levels(base_dim);
+   TextureStorage::level_index_type expected_levels = mipmap_levels(plan.base_dim);
    if (min_level + expected_levels <= max_level) {
       set_status_(status_warning);
       be_short_warn() << "Unnecessary mipmap levels removed: [ " << std::size_t(min_level + expected_levels) << ", " << std::size_t(max_level) << " ]" | default_log();
       max_level = min_level + expected_levels - 1;
    }
 
+   if (mipmap_filter_ != MipmapFilter::none) {
+      max_level = min_level + expected_levels - 1;
+   }
+
+   plan.generated.clear();
    for (TextureStorage::layer_index_type layer = min_layer; layer <= max_layer; ++layer) {
       for (TextureStorage::face_index_type face = min_face; face <= max_face; ++face) {
+         bool have_source = false;
          for (TextureStorage::level_index_type level = min_level; level <= max_level; ++level) {
-            constexpr int layer_bits = 8 * sizeof(TextureStorage::layer_index_type);
-            constexpr int face_bits = 8 * sizeof(TextureStorage::face_index_type);
-            constexpr int level_bits = 8 * sizeof(TextureStorage::level_index_type);
-
-            std::size_t img_id = (layer << (face_bits + level_bits)) | (face << level_bits) | level;
-            auto it = images.find(img_id);
-            if (it == images.end()) {
+            const image_ref_* ref = plan.images.find(ImageSlot { layer, face, level });
+            if (!ref && have_source && mipmap_filter_ != MipmapFilter::none) {
+               // Generated from the next larger level, whether it was provided or generated itself.
+               plan.complete = false;
+               plan.generated.push_back(image_ref_ { 0, 0, 0, 0, layer, face, level, mipmap_dim(plan.base_dim, level) });
+            } else if (!ref) {
+               plan.complete = false;
                set_status_(status_warning);
                be_short_warn() << "Missing image for layer " << std::size_t(layer) << " face " << std::size_t(face) << " level " << std::size_t(level) | default_log();
             } else {
-               auto dim = it->second.second.dim();
-               auto expected = mipmap_dim(base_dim, level);
+               have_source = true;
+               auto dim = ref->dim;
+               auto expected = mipmap_dim(plan.base_dim, level);
                if (dim != expected) {
+                  plan.complete = false;
                   set_status_(status_warning);
                   be_warn() << "Image size mismatch!"
-                     & attr("Source Path") << it->second.first->path.string()
+                     & attr("Source Path") << inputs[ref->input].path.string()
                      & attr("Width") << dim.x
                      & attr("Expected Width") << expected.x
                      & attr("Height") << dim.y
@@ -500,67 +776,154 @@ Texture AtexApp::make_texture_(const std::vector<input_>& inputs) {
       }
    }
 
-   assert(base_input != nullptr);
+   // Each level is generated from the one above it, so all images of a level are generated before the next.
+   std::stable_sort(plan.generated.begin(), plan.generated.end(), [](const image_ref_& a, const image_ref_& b) {
+      return a.level < b.level;
+   });
+
+   plan.layers = max_layer + 1;
+   plan.faces = max_face + 1;
+   plan.levels = max_level + 1;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Removes images which no output covers from the plan, so they are never converted (or when streaming, decoded).
+// Generated levels are filtered from the next larger level, so that level is kept whenever a generated level is.
+void AtexApp::prune_plan_(merge_plan_& plan, const std::vector<output_job_>& jobs) {
+   const std::size_t faces = plan.faces;
+   const std::size_t levels = plan.levels;
+   auto slot = [=](std::size_t layer, std::size_t face, std::size_t level) {
+      return (layer * faces + face) * levels + level;
+   };
+
+   std::vector<bool> needed(plan.layers * faces * levels, false);
+   for (const output_job_& job : jobs) {
+      const output_range_& range = job.range;
+      for (std::size_t layer = range.base_layer; layer < range.base_layer + range.layers; ++layer) {
+         for (std::size_t face = range.base_face; face < range.base_face + range.faces; ++face) {
+            for (std::size_t level = range.base_level; level < range.base_level + range.levels; ++level) {
+               needed[slot(layer, face, level)] = true;
+            }
+         }
+      }
+   }
+
+   // plan.generated is sorted by level, so walking it backwards visits each generated level before its source.
+   for (auto it = plan.generated.rbegin(); it != plan.generated.rend(); ++it) {
+      if (needed[slot(it->layer, it->face, it->level)]) {
+         needed[slot(it->layer, it->face, it->level - 1)] = true;
+      }
+   }
+
+   const std::size_t total = plan.images.size() + plan.generated.size();
+
+   ImageSlotIndex<image_ref_> images;
+   for (const image_ref_& ref : plan.images) {
+      if (needed[slot(ref.layer, ref.face, ref.level)]) {
+         images.insert(ImageSlot { ref.layer, ref.face, ref.level }, ref);
+      }
+   }
+   plan.images = std::move(images);
+
+   plan.generated.erase(std::remove_if(plan.generated.begin(), plan.generated.end(), [&](const image_ref_& ref) {
+         return !needed[slot(ref.layer, ref.face, ref.level)];
+      }), plan.generated.end());
 
-   TextureStorage::layer_index_type layers = max_layer + 1;
-   TextureStorage::face_index_type faces = max_face + 1;
-   TextureStorage::level_index_type levels = max_level + 1;
+   const std::size_t skipped = total - plan.images.size() - plan.generated.size();
+   if (skipped > 0) {
+      be_short_verbose() << "Skipping " << skipped << " images not written to any output" | default_log();
+   }
+}
 
-   TextureClass tex_class;
+///////////////////////////////////////////////////////////////////////////////
+TextureClass AtexApp::plan_texture_class_(const merge_plan_& plan, TextureClass base_class) const {
    if (override_tex_class_) {
-      tex_class = tex_class_;
-   } else {
-      tex_class = base_input->texture.view.texture_class();
-      if (layers > 1 && !is_array(tex_class)) {
-         switch (tex_class) {
-            case TextureClass::lineal: tex_class = TextureClass::lineal_array; break;
-            case TextureClass::planar: tex_class = TextureClass::planar_array; break;
-            case TextureClass::volumetric: tex_class = TextureClass::volumetric_array; break;
-            case TextureClass::directional: tex_class = TextureClass::directional_array; break;
-            default: break;
-         }
+      return tex_class_;
+   }
+
+   if (plan.layers > 1 && !is_array(base_class)) {
+      switch (base_class) {
+         case TextureClass::lineal: return TextureClass::lineal_array;
+         case TextureClass::planar: return TextureClass::planar_array;
+         case TextureClass::volumetric: return TextureClass::volumetric_array;
+         case TextureClass::directional: return TextureClass::directional_array;
+         default: break;
       }
    }
 
-   if (layers > 1 && !is_array(tex_class)) {
+   return base_class;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::plan_format_(merge_plan_& plan, const ConstTextureView& base_view, const std::vector<output_job_>& jobs) {
+   TextureClass tex_class = plan_texture_class_(plan, base_view.texture_class());
+
+   if (plan.layers > 1 && !is_array(tex_class)) {
       set_status_(status_warning);
       be_notice() << "Using non-array texture class for a texture with multiple layers"
          & attr("Texture Class") << tex_class
-         & attr("Layers") << std::size_t(layers)
+         & attr("Layers") << std::size_t(plan.layers)
          | default_log();
    }
 
-   if (faces != gfx::tex::faces(tex_class)) {
+   if (plan.faces != gfx::tex::faces(tex_class)) {
       set_status_(status_warning);
       be_notice() << "Face count conflict"
          & attr("Texture Class") << tex_class
-         & attr("Faces") << std::size_t(faces)
+         & attr("Faces") << std::size_t(plan.faces)
          & attr("Expected Faces") << std::size_t(gfx::tex::faces(tex_class))
          | default_log();
    }
 
-   if (base_dim.z > 1 && dimensionality(tex_class) < 3 ||
-       base_dim.y > 1 && dimensionality(tex_class) < 2) {
+   if (plan.base_dim.z > 1 && dimensionality(tex_class) < 3 ||
+       plan.base_dim.y > 1 && dimensionality(tex_class) < 2) {
       set_status_(status_warning);
       be_notice() << "Texture class dimensionality conflict"
          & attr("Texture Class") << tex_class
          & attr("Dimensionality") << std::size_t(dimensionality(tex_class))
-         & attr("Width") << base_dim.x
-         & attr("Height") << base_dim.y
-         & attr("Depth") << base_dim.z
+         & attr("Width") << plan.base_dim.x
+         & attr("Height") << plan.base_dim.y
+         & attr("Depth") << plan.base_dim.z
          | default_log();
    }
 
-   ImageFormat format = base_input->texture.view.format();
-   U8 block_span = base_input->texture.view.block_span();
+   ImageFormat format = base_view.format();
+   U8 block_span = base_view.block_span();
    if (override_block_) {
+      BlockCodec codec = block_codec(packing_, field_types_[0]);
       format.packing(packing_);
-      format.block_dim(ImageFormat::block_dim_type(1));
-      format.block_size(block_word_size(packing_) * block_word_count(packing_));
+      if (codec != BlockCodec::none) {
+         format.block_dim(ImageFormat::block_dim_type(4, 4, 1));
+         format.block_size(codec_block_size(codec));
+      } else {
+         format.block_dim(ImageFormat::block_dim_type(1));
+         format.block_size(block_word_size(packing_) * block_word_count(packing_));
+      }
       format.components(components_);
       format.field_types(field_types_);
       format.swizzles(swizzles_);
       block_span = block_span_;
+   } else if (can_decode(block_codec(format)) &&
+              std::any_of(jobs.begin(), jobs.end(), [](const output_job_& job) {
+                 return job.file_format != TextureFileFormat::betx &&
+                        job.file_format != TextureFileFormat::ktx &&
+                        job.file_format != TextureFileFormat::dds;
+              })) {
+      // Image file formats can't store compressed blocks, so decode them unless a packing was requested explicitly.
+      // Signed BC4 and BC5 blocks keep their sign, as decode_image produces it.
+      be_short_verbose() << "Decoding block compressed texels for image file output" | default_log();
+      const BlockCodec codec = block_codec(format);
+      const bool is_signed = (codec == BlockCodec::bc4 || codec == BlockCodec::bc5) && format.field_type(0) == FieldType::snorm;
+      format.packing(BlockPacking::s_8_8_8_8);
+      format.block_dim(ImageFormat::block_dim_type(1));
+      format.block_size(4);
+      ImageFormat::field_types_type field_types = format.field_types();
+      for (int f = 0; f < 4; ++f) {
+         field_types[f] = is_signed && f < 2 ? FieldType::snorm : FieldType::unorm;
+      }
+      format.field_types(field_types);
+      block_span = 4;
    }
 
    if (format.components() > field_count(format.packing())) {
@@ -574,6 +937,9 @@ Texture AtexApp::make_texture_(const std::vector<input_>& inputs) {
 
    std::size_t required_block_size = format.block_dim().x * format.block_dim().y * format.block_dim().z *
       block_word_size(format.packing()) * block_word_count(format.packing());
+   if (block_codec(format) != BlockCodec::none) {
+      required_block_size = codec_block_size(block_codec(format));
+   }
 
    if (required_block_size > format.block_size()) {
       set_status_(status_warning);
@@ -605,66 +971,507 @@ Texture AtexApp::make_texture_(const std::vector<input_>& inputs) {
       format.premultiplied(premultiplied_);
    }
 
-   TextureAlignment alignment;
    if (override_alignment_) {
-      alignment = TextureAlignment(line_alignment_bits_, plane_alignment_bits_, level_alignment_bits_, face_alignment_bits_, layer_alignment_bits_);
+      plan.alignment = TextureAlignment(line_alignment_bits_, plane_alignment_bits_, level_alignment_bits_, face_alignment_bits_, layer_alignment_bits_);
    } else {
-      alignment = base_input->texture.view.storage().alignment();
+      plan.alignment = base_view.storage().alignment();
    }
 
+   plan.tex_class = tex_class;
+   plan.format = format;
+   plan.block_span = block_span;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Texture AtexApp::allocate_texture_(const merge_plan_& plan) {
+   Texture result;
+
+   ProfileScope scope(profiler_.get(), ProfilePhase::allocate);
    try {
-      result.storage = std::make_unique<TextureStorage>(layers, faces, levels, base_dim, format.block_dim(), block_span, alignment);
+      result.storage = make_texture_storage(arena_.get(), plan.layers, plan.faces, plan.levels, plan.base_dim, plan.format.block_dim(), plan.block_span, plan.alignment);
    } catch (const std::bad_alloc&) {
       set_status_(status_conversion_error);
       log_exception(std::system_error(std::make_error_code(std::errc::not_enough_memory), "Not enough memory to allocate merged texture"));
       return result;
    }
 
-   result.view = TextureView(format, tex_class, *result.storage, 0, layers, 0, faces, 0, levels);
+   result.view = TextureView(plan.format, plan.tex_class, *result.storage, 0, plan.layers, 0, plan.faces, 0, plan.levels);
+   scope.bytes(result.storage->size());
+   return result;
+}
 
-   visit_texture_images(result.view, [&](ImageView& img) {
-      std::size_t layer = img.layer();
-      std::size_t face = img.face();
-      std::size_t level = img.level();
+///////////////////////////////////////////////////////////////////////////////
+bool AtexApp::blit_image_(const ConstTextureView& src, const image_ref_& ref, const TextureView& dest, EncodeQuality quality, Profiler* profiler) {
+   if (ref.level >= dest.levels() ||
+       ref.src_layer >= src.layers() || ref.src_face >= src.faces() || ref.src_level >= src.levels()) {
+      return true;
+   }
 
-      constexpr int layer_bits = 8 * sizeof(TextureStorage::layer_index_type);
-      constexpr int face_bits = 8 * sizeof(TextureStorage::face_index_type);
-      constexpr int level_bits = 8 * sizeof(TextureStorage::level_index_type);
+   ConstImageView src_img = view_image(src, ref.src_layer, ref.src_face, ref.src_level);
+   ImageView img = view_image(dest, ref.layer, ref.face, ref.level);
+   ProfileScope scope(profiler, ProfilePhase::blit);
+   scope.bytes(img.size());
+   const bool src_compressed = is_compressed(src_img.format().packing());
+   const bool dest_compressed = is_compressed(img.format().packing());
+   if (is_byte_identical(src_img, img)) {
+      copy_image_bytes(src_img, img);
+   } else if (src_compressed && dest_compressed) {
+      return transcode_image(src_img, img, quality);
+   } else if (src_compressed) {
+      return decode_image(src_img, img);
+   } else if (dest_compressed) {
+      return encode_image(src_img, img, quality);
+   } else {
+      blit_texels(src_img, ivec3(0), img, ivec3(0), glm::min(src_img.dim(), img.dim()));
+   }
+   return true;
+}
 
-      std::size_t img_id = (layer << (face_bits + level_bits)) | (face << level_bits) | level;
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::submit_blit_(const ConstTextureView& src, const image_ref_& ref, const TextureView& dest, std::vector<std::future<bool>>& blits) {
+   constexpr std::size_t min_tile_bytes = 1 << 20;
+
+   // Large uncompressed conversions are split into bands or slabs so a single huge image doesn't end up on one thread.
+   if (pool_->size() > 1 && ref.level < dest.levels() &&
+       ref.src_layer < src.layers() && ref.src_face < src.faces() && ref.src_level < src.levels()) {
+      ConstImageView src_img = view_image(src, ref.src_layer, ref.src_face, ref.src_level);
+      ImageView img = view_image(dest, ref.layer, ref.face, ref.level);
+      if (!is_compressed(src_img.format().packing()) && !is_compressed(img.format().packing()) && !is_byte_identical(src_img, img)) {
+         std::vector<ibox> tiles = split_blit(img, ivec3(0), glm::min(src_img.dim(), img.dim()), pool_->size() * 2, min_tile_bytes);
+         if (tiles.size() > 1) {
+            for (const ibox& tile : tiles) {
+               blits.push_back(pool_->submit([src_img, img, tile, profiler = profiler_.get()]() {
+                  ProfileScope scope(profiler, ProfilePhase::blit);
+                  scope.bytes(U64(tile.dim.x) * U64(tile.dim.y) * U64(tile.dim.z) * img.block_span());
+                  blit_texels(src_img, tile.offset, img, tile.offset, tile.dim);
+                  return true;
+               }));
+            }
+            return;
+         }
+      }
+   }
 
-      auto it = images.find(img_id);
-      if (it != images.end()) {
-         // TODO make sure we can do the conversion (eg. not converting to compressed)
+   blits.push_back(pool_->submit([src, ref, dest, quality = encode_quality_, profiler = profiler_.get()]() { return blit_image_(src, ref, dest, quality, profiler); }));
+}
 
-         ConstImageView src = it->second.second;
-         ImageRegion region = ImageRegion(pixel_region(src).extents().intersection(pixel_region(img).extents()));
-         blit_pixels(src, region, img, region);
+///////////////////////////////////////////////////////////////////////////////
+bool AtexApp::finish_blits_(std::vector<std::future<bool>>& blits, const ImageFormat& format) {
+   // Every blit must finish before returning, even if one of them threw, since they refer to the merged texture.
+   std::size_t failed = 0;
+   std::exception_ptr exception;
+   for (auto& blit : blits) {
+      try {
+         if (!blit.get()) {
+            ++failed;
+         }
+      } catch (...) {
+         if (!exception) {
+            exception = std::current_exception();
+         }
       }
-   });
+   }
+   blits.clear();
+
+   if (exception) {
+      std::rethrow_exception(exception);
+   }
+
+   if (failed > 0) {
+      set_status_(status_conversion_error);
+      be_error() << "Conversion between these block packings is not supported!"
+         & attr("Block Packing") << format.packing()
+         & attr("Images") << failed
+         | default_log();
+   }
+   return failed == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Texture AtexApp::make_texture_(std::vector<input_>& inputs, const merge_plan_& plan) {
+   // Storage shared with the decode cache can't be taken over, since later jobs may use it too.
+   if (inputs.size() == 1 && plan.complete && !override_alignment_ && inputs.front().texture.storage) {
+      input_& input = inputs.front();
+      TextureView& view = input.texture.view;
+      if (plan.format == view.format() && plan.block_span == view.block_span() &&
+          plan.layers == view.layers() && plan.faces == view.faces() && plan.levels == view.levels()) {
+         // The merged texture would be an exact copy of the input, so just take over its storage.
+         be_verbose() << "Input texture layout matches output; skipping merge" | default_log();
+         Texture result;
+         result.view = TextureView(plan.format, plan.tex_class, view.storage(),
+                                   view.base_layer(), plan.layers,
+                                   view.base_face(), plan.faces,
+                                   view.base_level(), plan.levels);
+         result.storage = std::move(input.texture.storage);
+         view = TextureView();
+         return result;
+      }
+   }
+
+   Texture result = allocate_texture_(plan);
+   if (result.view) {
+      std::vector<std::future<bool>> blits;
+      blits.reserve(plan.images.size());
+      for (const image_ref_& ref : plan.images) {
+         submit_blit_(inputs[ref.input].texture.view, ref, result.view, blits);
+      }
+      finish_blits_(blits, plan.format);
+      generate_mipmaps_(result.view, plan);
+   }
 
    return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_outputs_(TextureView view) {
-   for (output_file_ file : output_files_) {
-      file.path = fs::absolute(file.path, output_path_base_);
+void AtexApp::generate_mipmaps_(const TextureView& view, const merge_plan_& plan) {
+   if (plan.generated.empty()) {
+      return;
+   }
 
-      if (fs::exists(file.path) && !overwrite_output_files_) {
-         set_status_(status_write_error);
-         be_error() << "Skipping ouput file: file already exists; use --overwrite to ignore."
-            & attr(ids::log_attr_output_path) << file.path.string()
-            | default_log();
+   be_verbose() << "Generating mipmaps" | default_log();
+   ProfileScope scope(profiler_.get(), ProfilePhase::mipmap);
+
+   struct chain_ {
+      std::size_t level = 0;
+      bool loaded = false;
+      MipmapImage image;
+   };
+
+   // A float copy of the most recent level of each layer/face is kept, so generated levels are filtered from the
+   // previous level without being requantized in between.
+   std::map<std::pair<std::size_t, std::size_t>, chain_> chains;
+   for (const image_ref_& ref : plan.generated) {
+      chains[std::make_pair(ref.layer, ref.face)];
+   }
+
+   const FieldType field_type = plan.format.field_type(0);
+   const bool clamp_negative = field_type == FieldType::unorm || field_type == FieldType::uint || field_type == FieldType::ufloat;
+   const MipmapFilter filter = mipmap_filter_;
+   const EncodeQuality quality = encode_quality_;
+
+   std::vector<std::future<bool>> tasks;
+   std::vector<MipmapImage> next;
+   for (std::size_t begin = 0, end = 0; begin < plan.generated.size(); begin = end) {
+      const std::size_t level = plan.generated[begin].level;
+      end = begin;
+      while (end < plan.generated.size() && plan.generated[end].level == level) {
+         ++end;
+      }
+
+      for (std::size_t i = begin; i < end; ++i) {
+         const image_ref_& ref = plan.generated[i];
+         chain_& chain = chains[std::make_pair(ref.layer, ref.face)];
+         if (!chain.loaded || chain.level + 1 != level) {
+            chain.loaded = true;
+            chain.level = level - 1;
+            ConstImageView src = view_image(ConstTextureView(view), ref.layer, ref.face, level - 1);
+            tasks.push_back(pool_->submit([src, &chain]() { return load_mipmap_image(src, chain.image); }));
+         }
+      }
+      if (!finish_blits_(tasks, plan.format)) {
+         return;
+      }
+
+      // Split each image into bands of rows, so small numbers of large images still use every worker.
+      next.clear();
+      next.reserve(end - begin);
+      for (std::size_t i = begin; i < end; ++i) {
+         const image_ref_& ref = plan.generated[i];
+         const chain_& chain = chains[std::make_pair(ref.layer, ref.face)];
+         next.emplace_back(view_image(view, ref.layer, ref.face, level).dim());
+         const MipmapImage& dest = next.back();
+         const ivec3 dim = dest.dim();
+         const I32 band_rows = std::max(1, I32(65536 / std::max(1, dim.x * dim.z)));
+         for (I32 y = 0; y < dim.y; y += band_rows) {
+            tasks.push_back(pool_->submit([&chain, &dest, filter, y, band_rows, clamp_negative]() {
+               downsample_rows(chain.image, dest, filter, y, y + band_rows, clamp_negative);
+               return true;
+            }));
+         }
+      }
+      if (!finish_blits_(tasks, plan.format)) {
+         return;
+      }
+
+      for (std::size_t i = begin; i < end; ++i) {
+         const image_ref_& ref = plan.generated[i];
+         chain_& chain = chains[std::make_pair(ref.layer, ref.face)];
+         chain.image = std::move(next[i - begin]);
+         chain.level = level;
+         ImageView dest = view_image(view, ref.layer, ref.face, level);
+         tasks.push_back(pool_->submit([&chain, dest, quality]() { return store_mipmap_image(chain.image, dest, quality); }));
+      }
+      finish_blits_(tasks, plan.format);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<AtexApp::planned_input_> AtexApp::plan_inputs_(const std::vector<input_file_>& files, merge_plan_& plan, std::vector<input_>& inputs) {
+   std::vector<planned_input_> planned;
+
+   // Determine the layout of each input, preferably from the file header alone, so that the merged texture can be
+   // planned without holding any decoded inputs in memory.
+   std::vector<std::future<std::pair<TextureHeader, std::error_code>>> headers;
+   headers.reserve(files.size());
+   for (const input_file_& file : files) {
+      headers.push_back(pool_->submit([path = file.path, format = file.file_format]() {
+         std::error_code ec;
+         TextureHeader header = read_texture_header(path, format, ec);
+         return std::make_pair(header, ec);
+      }));
+   }
+
+   for (std::size_t i = 0; i < files.size(); ++i) {
+      const input_file_& file = files[i];
+      input_ input;
+      std::pair<TextureHeader, std::error_code> header = headers[i].get();
+
+      be_short_verbose() << "Planning " << file.file_format << " texture file: " << file.path.string() | default_log();
+
+      if (!prepare_input_(file, input)) {
          continue;
       }
 
-      S filename = file.path.filename().generic_string();
+      planned_input_ result { &file, input_layout_(), header.first };
+      if (!header.second) {
+         result.layout = header_layout_(file, header.first);
+      } else {
+         be_short_verbose() << "Layout can't be determined from file header; decoding " << file.path.string() | default_log();
+         apply_decoded_input_(file, read_input_(file), input);
+         if (!input.texture.view) {
+            continue;
+         }
+         result.layout = view_layout_(input.texture.view);
+         result.header_only = false;
+         result.header.file_format = input.file_format;
+         result.header.tex_class = input.texture.view.texture_class();
+         result.header.dim = input.texture.view.image().dim();
+         result.header.layers = input.texture.view.layers();
+         result.header.faces = input.texture.view.faces();
+         result.header.levels = input.texture.view.levels();
+         set_header_format(input.texture.view.format(), result.header);
+         input.texture = Texture();
+         input.mapping.reset();
+         input.contents.reset();
+         input.shared_storage.reset();
+      }
+
+      if (result.header_only && file.override_colorspace) {
+         result.header.colorspace = file.colorspace;
+      }
+
+      add_input_images_(file, input, inputs.size(), inputs, result.layout, plan);
+      inputs.push_back(std::move(input));
+      planned.push_back(std::move(result));
+   }
+
+   return planned;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<Path> AtexApp::stream_outputs_(const std::vector<input_file_>& files) {
+   std::vector<Path> written;
+   merge_plan_ plan;
+   std::vector<input_> inputs;
+   std::vector<planned_input_> planned = plan_inputs_(files, plan, inputs);
+
+
+   if (inputs.empty() || !plan_layout_(plan, inputs)) {
+      set_status_(status_no_input);
+      return written;
+   }
+
+   // Inputs which only contribute images that no output needs aren't decoded at all.
+   std::vector<output_job_> jobs = plan_outputs_(plan);
+   if (jobs.empty()) {
+      return written;
+   }
+   prune_plan_(plan, jobs);
+
+   // Second pass: decode each input that contributes at least one image, copy its images into the merged texture,
+   // then release it.  The base input is needed to determine the merged format, so it goes first.
+   std::vector<std::vector<const image_ref_*>> refs(inputs.size());
+   for (const image_ref_& ref : plan.images) {
+      refs[ref.input].push_back(&ref);
+   }
+
+   std::vector<std::size_t> order;
+   order.push_back(plan.base_input);
+   for (std::size_t i = 0; i < inputs.size(); ++i) {
+      if (i != plan.base_input && !refs[i].empty()) {
+         order.push_back(i);
+      }
+   }
+
+   Texture tex;
+   std::vector<std::size_t> pending;
+   std::vector<std::future<std::error_code>> results;
+
+   // Each output job is started as soon as every image it covers has been copied into the merged texture, so writing
+   // overlaps with decoding and copying the remaining inputs.
+   auto release_images = [&](std::size_t i) {
+      for (const image_ref_* ref : refs[i]) {
+         for (std::size_t j = 0; j < jobs.size(); ++j) {
+            if (pending[j] > 0 && covers_image_(jobs[j].view, *ref)) {
+               --pending[j];
+            }
+         }
+      }
+      submit_ready_outputs_(jobs, pending, results);
+   };
+
+   // Only file contents are read ahead, not decoded, so memory use stays bounded by the size of the files rather than
+   // their decoded textures.
+   std::vector<std::future<FileContents>> prefetched(order.size());
+   const std::size_t read_ahead = io_pool_->size() < 2 ? 0 : io_pool_->size();
+   std::size_t next_prefetch = 0;
+
+   try {
+      for (std::size_t n = 0; n < order.size(); ++n) {
+         for (; next_prefetch < order.size() && next_prefetch <= n + read_ahead; ++next_prefetch) {
+            prefetched[next_prefetch] = prefetch_input_(*planned[order[next_prefetch]].file);
+         }
+
+         const std::size_t i = order[n];
+         const input_file_& file = *planned[i].file;
+         input_& input = inputs[i];
+
+         be_short_info() << "Loading " << file.file_format << " texture file: " << file.path.string() | default_log();
+         apply_decoded_input_(file, read_prefetched_(file, prefetched[n]), input);
+         if (!input.texture.view) {
+            if (i == plan.base_input) {
+               set_status_(status_conversion_error);
+               return written;
+            }
+            release_images(i);
+            continue;
+         }
+
+         input_layout_ layout = view_layout_(input.texture.view);
+         if (layout.layers != planned[i].layout.layers || layout.faces != planned[i].layout.faces || layout.levels != planned[i].layout.levels ||
+             layout.level_dims != planned[i].layout.level_dims) {
+            set_status_(status_warning);
+            be_warn() << "Decoded texture layout does not match file header!"
+               & attr(ids::log_attr_path) << file.path.string()
+               & attr("Layers") << layout.layers
+               & attr("Expected Layers") << planned[i].layout.layers
+               & attr("Faces") << layout.faces
+               & attr("Expected Faces") << planned[i].layout.faces
+               & attr("Levels") << layout.levels
+               & attr("Expected Levels") << planned[i].layout.levels
+               | default_log();
+         }
+
+         if (i == plan.base_input) {
+            plan_format_(plan, input.texture.view, jobs);
+            tex = allocate_texture_(plan);
+            if (!tex.view) {
+               set_status_(status_conversion_error);
+               return written;
+            }
+
+            log_texture_info(tex.view, "Texture Info");
+
+            bind_outputs_(jobs, tex.view);
+            pending.assign(jobs.size(), 0);
+            results.resize(jobs.size());
+            for (std::size_t j = 0; j < jobs.size(); ++j) {
+               for (const image_ref_& ref : plan.images) {
+                  if (covers_image_(jobs[j].view, ref)) {
+                     ++pending[j];
+                  }
+               }
+               for (const image_ref_& ref : plan.generated) {
+                  if (covers_image_(jobs[j].view, ref)) {
+                     ++pending[j];
+                  }
+               }
+            }
+         }
+
+         std::vector<std::future<bool>> blits;
+         blits.reserve(refs[i].size());
+         for (const image_ref_* ref : refs[i]) {
+            submit_blit_(input.texture.view, *ref, tex.view, blits);
+         }
+         finish_blits_(blits, plan.format);
+
+         input.texture = Texture();
+         input.mapping.reset();
+         input.contents.reset();
+         input.shared_storage.reset();
+
+         release_images(i);
+      }
+
+      // Generated levels may depend on images from any input, so they're only filled in once everything is merged.
+      if (!plan.generated.empty()) {
+         generate_mipmaps_(tex.view, plan);
+         for (const image_ref_& ref : plan.generated) {
+            for (std::size_t j = 0; j < jobs.size(); ++j) {
+               if (pending[j] > 0 && covers_image_(jobs[j].view, ref)) {
+                  --pending[j];
+               }
+            }
+         }
+         submit_ready_outputs_(jobs, pending, results);
+      }
+   } catch (...) {
+      // Output jobs that were already started refer to the merged texture, so they must finish before it is destroyed.
+      for (auto& result : results) {
+         if (result.valid()) {
+            result.wait();
+         }
+      }
+      throw;
+   }
+
+   return finish_outputs_(jobs, results);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool AtexApp::covers_image_(const TextureView& view, const image_ref_& ref) {
+   return ref.layer >= view.base_layer() && ref.layer < view.base_layer() + view.layers() &&
+      ref.face >= view.base_face() && ref.face < view.base_face() + view.faces() &&
+      ref.level >= view.base_level() && ref.level < view.base_level() + view.levels();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<Path> AtexApp::write_outputs_(std::vector<output_job_>& jobs) {
+   std::vector<std::future<std::error_code>> results(jobs.size());
+   submit_ready_outputs_(jobs, std::vector<std::size_t>(jobs.size(), 0), results);
+   return finish_outputs_(jobs, results);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<AtexApp::output_job_> AtexApp::plan_outputs_(const merge_plan_& plan) {
+   return plan_outputs_(output_range_ { 0, plan.layers, 0, plan.faces, 0, plan.levels, plan.base_dim });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Points each job at its images in the merged texture, once it has been allocated.
+void AtexApp::bind_outputs_(std::vector<output_job_>& jobs, TextureView view) {
+   for (output_job_& job : jobs) {
+      job.view = TextureView(view.format(), view.texture_class(), view.storage(),
+                             view.base_layer() + job.range.base_layer, job.range.layers,
+                             view.base_face() + job.range.base_face, job.range.faces,
+                             view.base_level() + job.range.base_level, job.range.levels);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<AtexApp::output_job_> AtexApp::plan_outputs_(const output_range_& texture) {
+   std::vector<output_job_> jobs;
+
+   for (output_file_ file : output_files_) {
+      file.path = fs::absolute(file.path, output_path_base_);
+
+      const S filename = file.path.filename().generic_string();
+      const FilenameIndices indices = parse_filename_indices(filename);
 
       if (!file.force_layers) {
-         std::smatch m;
-         if (std::regex_search(filename, m, layer_regex())) {
-            S index = m[1].str();
+         if (!indices.layer.empty()) {
+            const S index(indices.layer);
             std::error_code ec;
             file.base_layer = util::parse_bounded_numeric_string<input_file_::layer_index_type>(index, 0, TextureStorage::max_layers - 1, 10, ec);
             file.layers = 1;
@@ -677,9 +1484,8 @@ void AtexApp::write_outputs_(TextureView view) {
       }
 
       if (!file.force_faces) {
-         std::smatch m;
-         if (std::regex_search(filename, m, face_regex())) {
-            S index = m[1].str();
+         if (!indices.face.empty()) {
+            const S index(indices.face);
             std::error_code ec;
             file.base_face = util::parse_bounded_numeric_string<input_file_::face_index_type>(index, 0, TextureStorage::max_faces - 1, 10, ec);
             file.faces = 1;
@@ -692,9 +1498,8 @@ void AtexApp::write_outputs_(TextureView view) {
       }
 
       if (!file.force_levels) {
-         std::smatch m;
-         if (std::regex_search(filename, m, level_regex())) {
-            S index = m[1].str();
+         if (!indices.level.empty()) {
+            const S index(indices.level);
             std::error_code ec;
             file.base_level = util::parse_bounded_numeric_string<input_file_::level_index_type>(index, 0, TextureStorage::max_levels - 1, 10, ec);
             file.levels = 1;
@@ -706,7 +1511,7 @@ void AtexApp::write_outputs_(TextureView view) {
          }
       }
 
-      if (file.base_layer >= view.layers()) {
+      if (file.base_layer >= texture.layers) {
          set_status_(status_write_error);
          be_error() << "Skipping ouput file: no layers selected!"
             & attr(ids::log_attr_output_path) << file.path.string()
@@ -714,7 +1519,7 @@ void AtexApp::write_outputs_(TextureView view) {
          continue;
       }
 
-      if (file.base_face >= view.faces()) {
+      if (file.base_face >= texture.faces) {
          set_status_(status_write_error);
          be_error() << "Skipping ouput file: no faces selected!"
             & attr(ids::log_attr_output_path) << file.path.string()
@@ -722,7 +1527,7 @@ void AtexApp::write_outputs_(TextureView view) {
          continue;
       }
 
-      if (file.base_level >= view.levels()) {
+      if (file.base_level >= texture.levels) {
          set_status_(status_write_error);
          be_error() << "Skipping ouput file: no levels selected!"
             & attr(ids::log_attr_output_path) << file.path.string()
@@ -730,10 +1535,13 @@ void AtexApp::write_outputs_(TextureView view) {
          continue;
       }
 
-      TextureView selected_view = TextureView(view.format(), view.texture_class(), view.storage(),
-                                              view.base_layer() + file.base_layer, file.layers,
-                                              view.base_face() + file.base_face, file.faces,
-                                              view.base_level() + file.base_level, file.levels);
+      output_range_ selected = texture;
+      selected.base_layer = file.base_layer;
+      selected.layers = std::min<std::size_t>(file.layers, texture.layers - file.base_layer);
+      selected.base_face = file.base_face;
+      selected.faces = std::min<std::size_t>(file.faces, texture.faces - file.base_face);
+      selected.base_level = file.base_level;
+      selected.levels = std::min<std::size_t>(file.levels, texture.levels - file.base_level);
 
       if (file.file_format == TextureFileFormat::unknown) {
          S ext = file.path.extension().generic_string();
@@ -768,178 +1576,297 @@ void AtexApp::write_outputs_(TextureView view) {
          case TextureFileFormat::betx:
          case TextureFileFormat::ktx:
          case TextureFileFormat::dds:
-            write_output_(selected_view, file.path, file.file_format, file.byte_order, file.payload_compression);
+            jobs.push_back(output_job_ { TextureView(), file.path, file.file_format, file.byte_order, file.payload_compression, file.png_effort, -1, selected });
             break;
 
          default:
             // image files don't support multiple layers/faces/levels
-            write_layer_images_(selected_view, file);
+            write_image_files_(selected, file, jobs);
             break;
       }
    }
+
+   // Check each destination path exactly once before any writing starts.  Jobs run concurrently, so two jobs must
+   // never target the same file; the result is the same as if they had been written one after another.
+   std::vector<output_job_> queued;
+   std::unordered_map<S, std::size_t> queued_paths;
+   for (output_job_& job : jobs) {
+      S key = job.path.string();
+      auto it = queued_paths.find(key);
+      if (it != queued_paths.end()) {
+         if (overwrite_output_files_) {
+            set_status_(status_warning);
+            be_warn() << "Output file will be written more than once; only the last will be kept."
+               & attr(ids::log_attr_output_path) << key
+               | default_log();
+            queued[it->second] = std::move(job);
+         } else {
+            set_status_(status_write_error);
+            be_error() << "Skipping ouput file: file already exists; use --overwrite to ignore."
+               & attr(ids::log_attr_output_path) << key
+               | default_log();
+         }
+         continue;
+      }
+
+      if (!overwrite_output_files_) {
+         if (fs::exists(job.path)) {
+            set_status_(status_write_error);
+            be_error() << "Skipping ouput file: file already exists; use --overwrite to ignore."
+               & attr(ids::log_attr_output_path) << key
+               | default_log();
+            continue;
+         }
+      }
+
+      queued_paths.emplace(std::move(key), queued.size());
+      queued.push_back(std::move(job));
+   }
+
+   return queued;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::future<std::error_code> AtexApp::submit_output_(const output_job_& job) {
+   be_short_info() << "Writing " << job.file_format << " texture file: " << job.path.string() | default_log();
+   return pool_->submit([this, job]() { return write_output_(job); });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_layer_images_(TextureView view, output_file_ file) {
+void AtexApp::submit_ready_outputs_(const std::vector<output_job_>& jobs, const std::vector<std::size_t>& pending, std::vector<std::future<std::error_code>>& results) {
+   std::vector<std::pair<std::size_t, std::size_t>> ready;
+   for (std::size_t i = 0; i < jobs.size(); ++i) {
+      if (pending[i] == 0 && !results[i].valid()) {
+         ready.emplace_back(output_cost_(jobs[i], output_bytes(jobs[i].view, jobs[i].depth)), i);
+      }
+   }
 
-   if (view.layers() <= 1) {
-      write_face_images_(view, std::move(file));
-   } else {
-      Path parent_path = file.path.parent_path();
-      S base = file.path.stem().string() + "-layer";
-      S ext = file.path.extension().string();
+   // Start the most expensive jobs (typically zlib compressed beTx files) first, so that they aren't left running
+   // alone on one thread after all the cheap jobs have finished.
+   std::stable_sort(ready.begin(), ready.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+   for (const auto& job : ready) {
+      results[job.second] = submit_output_(jobs[job.second]);
+   }
+}
 
-      for (TextureStorage::layer_index_type layer = TextureStorage::layer_index_type(view.base_layer());
-           layer < view.base_layer() + view.layers(); ++layer) {
-         file.path = parent_path / Path(base + std::to_string((std::size_t)layer) + ext);
-         TextureView layer_view = TextureView(view.format(), view.texture_class(), view.storage(),
-                                              layer, 1,
-                                              view.base_face(), view.faces(),
-                                              view.base_level(), view.levels());
-         write_face_images_(layer_view, file);
+///////////////////////////////////////////////////////////////////////////////
+std::vector<Path> AtexApp::finish_outputs_(const std::vector<output_job_>& jobs, std::vector<std::future<std::error_code>>& results) {
+   // Every job must finish before returning, even if one of them threw, since they all refer to the merged texture.
+   std::vector<Path> written;
+   std::exception_ptr exception;
+   for (std::size_t i = 0; i < results.size(); ++i) {
+      if (!results[i].valid()) {
+         continue;
+      }
+      try {
+         std::error_code ec = results[i].get();
+         if (ec) {
+            set_status_(status_write_error);
+            log_exception(fs::filesystem_error("Error writing output texture!", jobs[i].path, ec));
+         } else {
+            written.push_back(jobs[i].path);
+         }
+      } catch (...) {
+         if (!exception) {
+            exception = std::current_exception();
+         }
       }
    }
+
+   if (exception) {
+      std::rethrow_exception(exception);
+   }
+
+   return written;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_face_images_(TextureView view, output_file_ file) {
-   if (view.faces() <= 1) {
-      write_level_images_(view, std::move(file));
-   } else {
-      Path parent_path = file.path.parent_path();
-      S base = file.path.stem().string() + "-face";
-      S ext = file.path.extension().string();
+void AtexApp::write_image_files_(const output_range_& range, const output_file_& file, std::vector<output_job_>& jobs) {
+   output_name_ name;
+   name.parent = file.path.parent_path();
+   name.stem = file.path.stem().string();
+   name.ext = file.path.extension().string();
+   write_layer_images_(range, file, name, jobs);
+}
 
-      for (TextureStorage::face_index_type face = TextureStorage::face_index_type(view.base_face());
-           face < view.base_face() + view.faces(); ++face) {
-         file.path = parent_path / Path(base + std::to_string((std::size_t)face) + ext);
-         TextureView face_view = TextureView(view.format(), view.texture_class(), view.storage(),
-                                             view.base_layer(), view.layers(),
-                                             face, 1,
-                                             view.base_level(), view.levels());
-         write_level_images_(face_view, file);
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::write_layer_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs) {
+   if (range.layers <= 1) {
+      write_face_images_(range, file, name, jobs);
+   } else {
+      const std::size_t stem_size = name.stem.size();
+      for (std::size_t layer = range.base_layer; layer < range.base_layer + range.layers; ++layer) {
+         name.stem.append("-layer").append(std::to_string(layer));
+         output_range_ layer_range = range;
+         layer_range.base_layer = layer;
+         layer_range.layers = 1;
+         write_face_images_(layer_range, file, name, jobs);
+         name.stem.resize(stem_size);
       }
    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_level_images_(TextureView view, output_file_ file) {
-   if (view.levels() <= 1) {
-      write_plane_images_(view, std::move(file));
+void AtexApp::write_face_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs) {
+   if (range.faces <= 1) {
+      write_level_images_(range, file, name, jobs);
    } else {
-      Path parent_path = file.path.parent_path();
-      S base = file.path.stem().string() + "-level";
-      S ext = file.path.extension().string();
+      const std::size_t stem_size = name.stem.size();
+      for (std::size_t face = range.base_face; face < range.base_face + range.faces; ++face) {
+         name.stem.append("-face").append(std::to_string(face));
+         output_range_ face_range = range;
+         face_range.base_face = face;
+         face_range.faces = 1;
+         write_level_images_(face_range, file, name, jobs);
+         name.stem.resize(stem_size);
+      }
+   }
+}
 
-      for (TextureStorage::level_index_type level = TextureStorage::level_index_type(view.base_level());
-           level < view.base_level() + view.levels(); ++level) {
-         file.path = parent_path / Path(base + std::to_string((std::size_t)level) + ext);
-         TextureView level_view = TextureView(view.format(), view.texture_class(), view.storage(),
-                                              view.base_layer(), view.layers(),
-                                              view.base_face(), view.faces(),
-                                              level, 1);
-         write_plane_images_(level_view, file);
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::write_level_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs) {
+   if (range.levels <= 1) {
+      write_plane_images_(range, file, name, jobs);
+   } else {
+      const std::size_t stem_size = name.stem.size();
+      for (std::size_t level = range.base_level; level < range.base_level + range.levels; ++level) {
+         name.stem.append("-level").append(std::to_string(level));
+         output_range_ level_range = range;
+         level_range.base_level = level;
+         level_range.levels = 1;
+         write_plane_images_(level_range, file, name, jobs);
+         name.stem.resize(stem_size);
       }
    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_plane_images_(TextureView view, output_file_ file) {
-   I32 depth = view.image().dim().z;
+void AtexApp::write_plane_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs) {
+   I32 depth = mipmap_dim(range.dim, range.base_level).z;
    if (depth <= 1) {
-      write_output_(view, file.path, file.file_format, file.byte_order, file.payload_compression, 0);
+      jobs.push_back(output_job_ { TextureView(), name.parent / Path(name.stem + name.ext), file.file_format, file.byte_order, file.payload_compression, file.png_effort, 0, range });
    } else {
-      Path parent_path = file.path.parent_path();
-      S base = file.path.stem().string() + "-z";
-      S ext = file.path.extension().string();
-
+      const std::size_t stem_size = name.stem.size();
       for (I32 z = 0; z < depth; ++z) {
-         file.path = parent_path / Path(base + std::to_string((std::size_t)z) + ext);
-         write_output_(view, file.path, file.file_format, file.byte_order, file.payload_compression, z);
+         name.stem.append("-z").append(std::to_string((std::size_t)z)).append(name.ext);
+         jobs.push_back(output_job_ { TextureView(), name.parent / Path(name.stem), file.file_format, file.byte_order, file.payload_compression, file.png_effort, z, range });
+         name.stem.resize(stem_size);
       }
    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void AtexApp::write_output_(TextureView view, const Path& path, TextureFileFormat format, ByteOrderType byte_order, bool payload_compression, I32 depth) {
+std::error_code AtexApp::write_output_(const output_job_& job) const {
    std::error_code ec;
+   ProfileScope scope(profiler_.get(), ProfilePhase::write, job.path.string());
 
-   be_short_info() << "Writing " << format << " texture file: " << path.string() | default_log();
-
-   
-      if (fs::exists(path) && !overwrite_output_files_) {
-         set_status_(status_write_error);
-         be_error() << "Skipping ouput file: file already exists; use --overwrite to ignore."
-            & attr(ids::log_attr_output_path) << path.string()
-            | default_log();
-         return;
-      }
+   if (!cache_path_.empty() && overwrite_output_files_) {
+      // The existing file may be a hard link into the cache; unlink it so the writer doesn't modify the cached copy.
+      // This is only done once the output is about to be written, so a failed merge leaves the old file in place.
+      fs::remove(job.path, ec);
+      ec.clear();
+   }
 
-   switch (format) {
+   switch (job.file_format) {
       case TextureFileFormat::betx:
       {
          BetxWriter writer;
-         writer.payload_compression(payload_compression ? BetxWriter::PayloadCompressionMode::zlib : BetxWriter::PayloadCompressionMode::none);
-         writer.endianness(byte_order);
-         writer.texture(view);
-         writer.write(path, ec);
+         writer.payload_compression(job.payload_compression ? BetxWriter::PayloadCompressionMode::zlib : BetxWriter::PayloadCompressionMode::none);
+         writer.endianness(job.byte_order);
+         writer.texture(job.view);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::ktx:
       {
          KtxWriter writer;
-         writer.endianness(byte_order);
-         writer.texture(view);
-         writer.write(path, ec);
+         writer.endianness(job.byte_order);
+         writer.texture(job.view);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::png:
       {
          PngWriter writer;
-         writer.image(view.image(), depth);
-         writer.write(path, ec);
+         writer.image(job.view.image(), job.depth);
+         writer.write(job.path, ec);
+         if (!ec && job.png_effort > 0) {
+            ec = optimize_png_file_(job.path, job.png_effort);
+         }
          break;
       }
       case TextureFileFormat::tga:
       {
          TgaWriter writer;
-         writer.image(view.image(), depth);
-         writer.use_rle(payload_compression);
-         writer.write(path, ec);
+         writer.image(job.view.image(), job.depth);
+         writer.use_rle(job.payload_compression);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::bmp:
       {
          BmpWriter writer;
-         writer.image(view.image(), depth);
-         writer.write(path, ec);
+         writer.image(job.view.image(), job.depth);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::hdr:
       {
          HdrWriter writer;
-         writer.image(view.image(), depth);
-         writer.write(path, ec);
+         writer.image(job.view.image(), job.depth);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::jpeg:
       {
          JpegWriter writer;
-         writer.image(view.image(), depth);
+         writer.image(job.view.image(), job.depth);
          writer.quality(jpeg_quality_);
-         writer.write(path, ec);
+         writer.write(job.path, ec);
          break;
       }
       case TextureFileFormat::dds:
-         // TODO
+      {
+         DdsWriter writer;
+         writer.texture(job.view);
+         writer.write(job.path, ec);
+         break;
+      }
       default:
          ec = std::make_error_code(std::errc::not_supported);
          break;
    }
-   if (ec) {
-      set_status_(status_write_error);
-      log_exception(fs::filesystem_error("Error writing output texture!", path, ec));
+
+   if (profiler_ && !ec) {
+      std::error_code size_ec;
+      const auto size = fs::file_size(job.path, size_ec);
+      scope.bytes(size_ec ? 0 : U64(size));
+   }
+   return ec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::error_code AtexApp::optimize_png_file_(const Path& path, U8 effort) const {
+   std::error_code ec;
+   std::vector<UC> data;
+   {
+      std::ifstream ifs(path.string(), std::ios::binary);
+      data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+      if (!ifs.eof() && ifs.fail()) {
+         return std::make_error_code(std::errc::io_error);
+      }
+   }
+
+   if (optimize_png(data, effort, pool_.get())) {
+      std::ofstream ofs(path.string(), std::ios::binary | std::ios::trunc);
+      ofs.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+      ofs.close();
+      if (!ofs) {
+         ec = std::make_error_code(std::errc::io_error);
+      }
    }
+   return ec;
 }
 
 } // be::atex
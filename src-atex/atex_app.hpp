@@ -2,22 +2,37 @@
 #ifndef BE_ATEX_ATEX_APP_HPP_
 #define BE_ATEX_ATEX_APP_HPP_
 
+#include "filename_indices.hpp"
+#include "image_slot_index.hpp"
+#include "../src-tools-gfx/arena.hpp"
+#include "../src-tools-gfx/blit_kernels.hpp"
+#include "../src-tools-gfx/block_codec.hpp"
+#include "../src-tools-gfx/decode_cache.hpp"
+#include "../src-tools-gfx/dds_writer.hpp"
+#include "../src-tools-gfx/exception_logging.hpp"
+#include "../src-tools-gfx/mipmap_filter.hpp"
+#include "../src-tools-gfx/png_optimizer.hpp"
+#include "../src-tools-gfx/texture_header.hpp"
+#include "../src-tools-gfx/texture_io.hpp"
+#include "../src-tools-gfx/worker_pool.hpp"
 #include <be/core/lifecycle.hpp>
 #include <be/core/filesystem.hpp>
 #include <be/gfx/tex/texture.hpp>
 #include <be/gfx/tex/texture_file_format.hpp>
 #include <be/core/glm.hpp>
 #include <be/core/byte_order.hpp>
+#include <optional>
 
-// TODO ktx, dds, glraw read/write
+// TODO dds, glraw read
+// TODO glraw write
 // TODO stbiw png, tga, hdr, bmp write
 // TODO libpng read/write
-// TODO S3TC decoding
-// TODO RGTC decoding
-// TODO BPTC decoding
+// TODO BPTC float (BC6H) decoding
 
 namespace be::atex {
 
+using namespace tools;
+
 ///////////////////////////////////////////////////////////////////////////////
 class AtexApp final {
 public:
@@ -26,6 +41,8 @@ public:
    int operator()();
 
 private:
+   AtexApp(int argc, char** argv, const AtexApp& batch);
+
    enum status_code_ : U8 {
       status_ok = 0,
       status_warning,
@@ -71,11 +88,50 @@ private:
    struct input_ {
       Path path;
       gfx::tex::TextureFileFormat file_format = gfx::tex::TextureFileFormat::unknown;
+      std::shared_ptr<MappedFile> mapping; // must outlive texture, since its storage may refer to the mapped file
+      std::shared_ptr<const std::vector<UC>> contents; // likewise for file contents read by the I/O pool
+      std::shared_ptr<gfx::tex::TextureStorage> shared_storage; // owns the texture's storage instead of texture.storage when it came from the decode cache
       gfx::tex::Texture texture;
       gfx::tex::TextureStorage::layer_index_type dest_layer = gfx::tex::TextureStorage::max_layers;
       gfx::tex::TextureStorage::face_index_type dest_face = gfx::tex::TextureStorage::max_faces;
       gfx::tex::TextureStorage::level_index_type dest_level = gfx::tex::TextureStorage::max_levels;
    };
+   struct input_layout_ {
+      std::size_t layers = 0;
+      std::size_t faces = 0;
+      std::size_t levels = 0;
+      std::vector<ivec3> level_dims;
+   };
+   struct planned_input_ {
+      const input_file_* file;
+      input_layout_ layout;
+      TextureHeader header;
+      bool header_only = true; // false if the file had to be decoded to determine its layout
+   };
+   struct image_ref_ {
+      std::size_t input;
+      std::size_t src_layer;
+      std::size_t src_face;
+      std::size_t src_level;
+      std::size_t layer;
+      std::size_t face;
+      std::size_t level;
+      ivec3 dim;
+   };
+   struct merge_plan_ {
+      ImageSlotIndex<image_ref_> images;
+      std::vector<image_ref_> generated;
+      std::size_t base_input = 0;
+      ivec3 base_dim;
+      gfx::tex::TextureStorage::layer_index_type layers = 0;
+      gfx::tex::TextureStorage::face_index_type faces = 0;
+      gfx::tex::TextureStorage::level_index_type levels = 0;
+      bool complete = true;
+      gfx::tex::TextureClass tex_class;
+      gfx::tex::ImageFormat format;
+      U8 block_span = 0;
+      gfx::tex::TextureAlignment alignment;
+   };
 
    struct output_file_ {
       using layer_index_type = gfx::tex::TextureStorage::layer_index_type;
@@ -99,25 +155,110 @@ private:
 
       ByteOrderType byte_order = bo::Host::value;
       bool payload_compression = false;
+      U8 png_effort = 0;
+   };
+   // The parts of an output path; the stem grows a -layerN, -faceN, etc. suffix for each image written.
+   struct output_name_ {
+      Path parent;
+      S stem;
+      S ext;
+   };
+   // The images of the merged texture selected for an output, relative to the whole texture; dim is the size of the
+   // merged texture's level 0, so outputs can be planned before the texture exists.
+   struct output_range_ {
+      std::size_t base_layer = 0;
+      std::size_t layers = 0;
+      std::size_t base_face = 0;
+      std::size_t faces = 0;
+      std::size_t base_level = 0;
+      std::size_t levels = 0;
+      ivec3 dim;
+   };
+   struct output_job_ {
+      gfx::tex::TextureView view;
+      Path path;
+      gfx::tex::TextureFileFormat file_format;
+      ByteOrderType byte_order;
+      bool payload_compression;
+      U8 png_effort;
+      I32 depth = -1;
+      output_range_ range;
    };
 
+   void process_cli_(int argc, char** argv);
    void set_status_(status_code_ status);
-
-   std::vector<input_> load_inputs_();
-   input_ load_input_(const input_file_& file);
-   gfx::tex::Texture make_texture_(const std::vector<input_>& inputs);
-   void write_outputs_(gfx::tex::TextureView view);
-   void write_layer_images_(gfx::tex::TextureView view, output_file_ file);
-   void write_face_images_(gfx::tex::TextureView view, output_file_ file);
-   void write_level_images_(gfx::tex::TextureView view, output_file_ file);
-   void write_plane_images_(gfx::tex::TextureView view, output_file_ file);
-   void write_output_(gfx::tex::TextureView view, const Path& path, gfx::tex::TextureFileFormat format, ByteOrderType byte_order, bool payload_compression, I32 depth = -1);
-
-   CoreInitLifecycle init_;
+   void init_pool_();
+   void init_decode_cache_();
+   void run_();
+   void report_profile_();
+   void run_batch_();
+   static std::vector<S> split_command_line_(const S& line);
+   int run_job_(std::vector<S> args, std::vector<Path>* outputs);
+   void run_serve_();
+   void run_probe_(const std::vector<input_file_>& files);
+
+   std::vector<input_file_> find_inputs_();
+   U64 cache_key_(const std::vector<input_file_>& files);
+   bool restore_cached_outputs_(U64 key);
+   void store_cached_outputs_(U64 key, const std::vector<Path>& outputs);
+   std::vector<input_> load_inputs_(const std::vector<input_file_>& files, merge_plan_& plan);
+   DecodedTexture read_input_(const input_file_& file) const;
+   std::future<DecodedTexture> submit_read_(const input_file_& file);
+   std::future<FileContents> prefetch_input_(const input_file_& file);
+   DecodedTexture read_prefetched_(const input_file_& file, std::future<FileContents>& contents);
+   input_ load_input_(const input_file_& file, std::future<DecodedTexture>& decoded);
+   bool prepare_input_(const input_file_& file, input_& result);
+   void apply_decoded_input_(const input_file_& file, DecodedTexture data, input_& result);
+   static input_layout_ view_layout_(const gfx::tex::ConstTextureView& view);
+   static input_layout_ header_layout_(const input_file_& file, const TextureHeader& header);
+   std::vector<planned_input_> plan_inputs_(const std::vector<input_file_>& files, merge_plan_& plan, std::vector<input_>& inputs);
+   void add_input_images_(const input_file_& file, const input_& input, std::size_t index, const std::vector<input_>& inputs, const input_layout_& layout, merge_plan_& plan);
+   bool plan_layout_(merge_plan_& plan, const std::vector<input_>& inputs);
+   gfx::tex::TextureClass plan_texture_class_(const merge_plan_& plan, gfx::tex::TextureClass base_class) const;
+   void prune_plan_(merge_plan_& plan, const std::vector<output_job_>& jobs);
+   void plan_format_(merge_plan_& plan, const gfx::tex::ConstTextureView& base_view, const std::vector<output_job_>& jobs);
+   gfx::tex::Texture allocate_texture_(const merge_plan_& plan);
+   static bool blit_image_(const gfx::tex::ConstTextureView& src, const image_ref_& ref, const gfx::tex::TextureView& dest, EncodeQuality quality, Profiler* profiler);
+   void submit_blit_(const gfx::tex::ConstTextureView& src, const image_ref_& ref, const gfx::tex::TextureView& dest, std::vector<std::future<bool>>& blits);
+   bool finish_blits_(std::vector<std::future<bool>>& blits, const gfx::tex::ImageFormat& format);
+   gfx::tex::Texture make_texture_(std::vector<input_>& inputs, const merge_plan_& plan);
+   void generate_mipmaps_(const gfx::tex::TextureView& view, const merge_plan_& plan);
+   std::vector<Path> stream_outputs_(const std::vector<input_file_>& files);
+   static bool covers_image_(const gfx::tex::TextureView& view, const image_ref_& ref);
+   std::vector<Path> write_outputs_(std::vector<output_job_>& jobs);
+   std::vector<output_job_> plan_outputs_(const merge_plan_& plan);
+   std::vector<output_job_> plan_outputs_(const output_range_& texture);
+   static void bind_outputs_(std::vector<output_job_>& jobs, gfx::tex::TextureView view);
+   void submit_ready_outputs_(const std::vector<output_job_>& jobs, const std::vector<std::size_t>& pending, std::vector<std::future<std::error_code>>& results);
+   static std::size_t output_cost_(const output_job_& job, std::size_t bytes);
+   std::future<std::error_code> submit_output_(const output_job_& job);
+   std::vector<Path> finish_outputs_(const std::vector<output_job_>& jobs, std::vector<std::future<std::error_code>>& results);
+   void write_image_files_(const output_range_& range, const output_file_& file, std::vector<output_job_>& jobs);
+   void write_layer_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs);
+   void write_face_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs);
+   void write_level_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs);
+   void write_plane_images_(const output_range_& range, const output_file_& file, output_name_& name, std::vector<output_job_>& jobs);
+   std::error_code write_output_(const output_job_& job) const;
+   std::error_code optimize_png_file_(const Path& path, U8 effort) const;
+
+   std::optional<CoreInitLifecycle> init_;
    I8 status_ = 0;
 
+   U16 jobs_ = 1;
+   std::shared_ptr<WorkerPool> pool_;
+   U16 io_depth_ = 4;
+   std::shared_ptr<WorkerPool> io_pool_; // blocking file reads, so they don't hold up decoding
+   std::shared_ptr<Arena> arena_; // merged texture payloads in batch and server jobs; reset after each job
+   std::shared_ptr<DecodeCache> decode_cache_; // only in batch and server mode
+   U32 decode_cache_mb_ = 256;
+   Path batch_path_;
+   Path serve_path_;
+
    std::vector<Path> input_search_paths_;
    std::vector<input_file_> input_files_;
+   bool map_input_files_ = false;
+   bool stream_inputs_ = false;
+   bool probe_ = false;
 
    bool override_block_ = false;
    gfx::tex::BlockPacking packing_ = gfx::tex::BlockPacking::s_8_8_8_8;
@@ -125,6 +266,8 @@ private:
    gfx::tex::ImageFormat::field_types_type field_types_;
    gfx::tex::ImageFormat::swizzles_type swizzles_ = gfx::tex::swizzles_rgba();
    U8 block_span_ = 0;
+   EncodeQuality encode_quality_ = EncodeQuality::normal;
+   MipmapFilter mipmap_filter_ = MipmapFilter::none;
 
    bool override_colorspace_ = false;
    gfx::tex::Colorspace colorspace_ = gfx::tex::Colorspace::srgb;
@@ -146,6 +289,13 @@ private:
    std::vector<output_file_> output_files_;
    bool overwrite_output_files_ = false;
    int jpeg_quality_ = 70;
+
+   Path cache_path_;
+   std::vector<Path> written_outputs_; // reported back to --serve clients
+
+   bool profile_ = false;
+   Path stats_json_path_;
+   std::unique_ptr<Profiler> profiler_;
 };
 
 } // be::atex
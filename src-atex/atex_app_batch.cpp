@@ -0,0 +1,156 @@
+#include "atex_app.hpp"
+#include <be/core/log_exception.hpp>
+#include <be/core/logging.hpp>
+#include <fstream>
+#include <iostream>
+
+namespace be::atex {
+
+///////////////////////////////////////////////////////////////////////////////
+// Splits a single batch file line into arguments.  Arguments are separated by
+// whitespace, and may be quoted with single or double quotes.  Within double
+// quotes, a backslash escapes the next character.
+std::vector<S> AtexApp::split_command_line_(const S& line) {
+   std::vector<S> args;
+   S arg;
+   bool in_arg = false;
+   char quote = 0;
+
+   for (std::size_t i = 0; i < line.size(); ++i) {
+      char c = line[i];
+      if (quote != 0) {
+         if (c == quote) {
+            quote = 0;
+         } else if (c == '\\' && quote == '"' && i + 1 < line.size()) {
+            arg.push_back(line[++i]);
+         } else {
+            arg.push_back(c);
+         }
+      } else if (c == '"' || c == '\'') {
+         quote = c;
+         in_arg = true;
+      } else if (c == ' ' || c == '\t' || c == '\r') {
+         if (in_arg) {
+            args.push_back(std::move(arg));
+            arg.clear();
+            in_arg = false;
+         }
+      } else {
+         arg.push_back(c);
+         in_arg = true;
+      }
+   }
+
+   if (quote != 0) {
+      throw std::runtime_error("Unterminated quote");
+   }
+
+   if (in_arg) {
+      args.push_back(std::move(arg));
+   }
+
+   return args;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int AtexApp::run_job_(std::vector<S> args, std::vector<Path>* outputs) {
+   args.insert(args.begin(), "atex");
+   std::vector<char*> argv;
+   argv.reserve(args.size() + 1);
+   for (S& arg : args) {
+      argv.push_back(arg.data());
+   }
+   argv.push_back(nullptr);
+
+   auto verbosity = default_log().verbosity_mask();
+
+   int job_status;
+   {
+      AtexApp job(int(args.size()), argv.data(), *this);
+      job_status = job();
+      if (outputs) {
+         *outputs = std::move(job.written_outputs_);
+      }
+   }
+
+   // Nothing from the job refers to arena memory once it's destroyed, so the next job can reuse it.
+   arena_->reset();
+
+   default_log().verbosity_mask(verbosity);
+   return job_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::run_batch_() {
+   std::ifstream file;
+   std::istream* is = &std::cin;
+   if (batch_path_ != "-") {
+      file.open(batch_path_.string());
+      if (!file) {
+         set_status_(status_no_input);
+         be_error() << "Could not open batch file!"
+            & attr(ids::log_attr_path) << batch_path_.string()
+            | default_log();
+         return;
+      }
+      is = &file;
+   }
+
+   init_pool_();
+   init_decode_cache_();
+   arena_ = std::make_shared<Arena>();
+
+   std::size_t line_number = 0;
+   std::size_t jobs = 0;
+   std::size_t failed_jobs = 0;
+   S line;
+   while (std::getline(*is, line)) {
+      ++line_number;
+
+      std::vector<S> args;
+      try {
+         args = split_command_line_(line);
+      } catch (const std::exception& e) {
+         set_status_(status_cli_error);
+         be_error() << "Could not parse batch file line!"
+            & attr(ids::log_attr_message) << S(e.what())
+            & attr("Line") << line_number
+            | default_log();
+         ++failed_jobs;
+         continue;
+      }
+
+      if (args.empty() || args.front()[0] == '#') {
+         continue;
+      }
+
+      ++jobs;
+      be_short_verbose() << "Starting batch job " << jobs << " (line " << line_number << ")" | default_log();
+
+      int job_status = run_job_(std::move(args), nullptr);
+
+      if (job_status > status_warning) {
+         ++failed_jobs;
+         be_warn() << "Batch job failed!"
+            & attr("Line") << line_number
+            & attr("Status") << job_status
+            | default_log();
+      } else {
+         be_short_verbose() << "Batch job " << jobs << " finished with status " << job_status | default_log();
+      }
+
+      set_status_(static_cast<status_code_>(job_status));
+   }
+
+   if (is->bad()) {
+      set_status_(status_exception);
+      log_exception(std::system_error(std::make_error_code(std::errc::io_error), "Error reading batch file: " + batch_path_.string()));
+   }
+
+   be_short_info() << "Batch complete: " << jobs << " jobs, " << failed_jobs << " failed" | default_log();
+   if (decode_cache_) {
+      be_short_verbose() << "Decode cache: " << decode_cache_->hits() << " hits, " << decode_cache_->misses() << " misses" | default_log();
+   }
+}
+
+} // be::atex
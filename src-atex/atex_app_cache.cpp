@@ -0,0 +1,271 @@
+#include "atex_app.hpp"
+#include "version.hpp"
+#include <be/core/log_exception.hpp>
+#include <be/core/logging.hpp>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+namespace be::atex {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+// 64-bit FNV-1a; used to build cache keys, so it must produce the same value
+// on every platform and in every process.
+class Fnv1a final {
+public:
+   void add(const void* data, std::size_t size) {
+      const UC* ptr = static_cast<const UC*>(data);
+      for (std::size_t i = 0; i < size; ++i) {
+         value_ = (value_ ^ ptr[i]) * 0x100000001b3ull;
+      }
+   }
+
+   void add(const S& str) {
+      add_value(U64(str.size()));
+      add(str.data(), str.size());
+   }
+
+   template <typename T>
+   void add_value(const T& value) {
+      static_assert(std::is_trivially_copyable<T>::value, "Value must be trivially copyable!");
+      add(&value, sizeof(T));
+   }
+
+   U64 value() const {
+      return value_;
+   }
+
+private:
+   U64 value_ = 0xcbf29ce484222325ull;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+U64 hash_file_contents(const Path& path) {
+   Fnv1a hash;
+   std::ifstream is(path.string(), std::ios::binary);
+   std::vector<char> buf(64 * 1024);
+   while (is) {
+      is.read(buf.data(), buf.size());
+      std::size_t count = std::size_t(is.gcount());
+      hash.add_value(U64(count));
+      hash.add(buf.data(), count);
+   }
+   return hash.value();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+S key_string(U64 key) {
+   static const char digits[] = "0123456789abcdef";
+   S str(16, '0');
+   for (std::size_t i = 0; i < 16; ++i) {
+      str[15 - i] = digits[key & 0xF];
+      key >>= 4;
+   }
+   return str;
+}
+
+} // be::atex::()
+
+///////////////////////////////////////////////////////////////////////////////
+U64 AtexApp::cache_key_(const std::vector<input_file_>& files) {
+   std::vector<std::future<U64>> contents;
+   contents.reserve(files.size());
+   for (const input_file_& file : files) {
+      contents.push_back(pool_->submit([path = file.path]() { return hash_file_contents(path); }));
+   }
+
+   Fnv1a hash;
+   hash.add(S(BE_ATEX_VERSION_STRING));
+
+   hash.add_value(U64(files.size()));
+   for (std::size_t i = 0; i < files.size(); ++i) {
+      const input_file_& file = files[i];
+      hash.add(file.path.string());
+      hash.add_value(contents[i].get());
+      hash.add_value(file.file_format);
+      hash.add_value(file.layer);
+      hash.add_value(file.first_layer);
+      hash.add_value(file.last_layer);
+      hash.add_value(file.face);
+      hash.add_value(file.first_face);
+      hash.add_value(file.last_face);
+      hash.add_value(file.level);
+      hash.add_value(file.first_level);
+      hash.add_value(file.last_level);
+      hash.add_value(file.override_components);
+      hash.add_value(file.field_types);
+      hash.add_value(file.swizzles);
+      hash.add_value(file.override_colorspace);
+      hash.add_value(file.colorspace);
+      hash.add_value(file.override_premultiplied);
+      hash.add_value(file.premultiplied);
+   }
+
+   hash.add_value(override_block_);
+   hash.add_value(packing_);
+   hash.add_value(components_);
+   hash.add_value(field_types_);
+   hash.add_value(swizzles_);
+   hash.add_value(block_span_);
+   hash.add_value(encode_quality_);
+   hash.add_value(mipmap_filter_);
+   hash.add_value(override_colorspace_);
+   hash.add_value(colorspace_);
+   hash.add_value(override_premultiplied_);
+   hash.add_value(premultiplied_);
+   hash.add_value(override_alignment_);
+   hash.add_value(line_alignment_bits_);
+   hash.add_value(plane_alignment_bits_);
+   hash.add_value(level_alignment_bits_);
+   hash.add_value(face_alignment_bits_);
+   hash.add_value(layer_alignment_bits_);
+   hash.add_value(override_tex_class_);
+   hash.add_value(tex_class_);
+   hash.add_value(jpeg_quality_);
+
+   hash.add_value(U64(output_files_.size()));
+   for (const output_file_& file : output_files_) {
+      hash.add(fs::absolute(file.path, output_path_base_).string());
+      hash.add_value(file.file_format);
+      hash.add_value(file.force_layers);
+      hash.add_value(file.base_layer);
+      hash.add_value(file.layers);
+      hash.add_value(file.force_faces);
+      hash.add_value(file.base_face);
+      hash.add_value(file.faces);
+      hash.add_value(file.force_levels);
+      hash.add_value(file.base_level);
+      hash.add_value(file.levels);
+      hash.add_value(file.byte_order);
+      hash.add_value(file.payload_compression);
+      hash.add_value(file.png_effort);
+   }
+
+   be_short_verbose() << "Cache key: " << key_string(hash.value()) | default_log();
+   return hash.value();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool AtexApp::restore_cached_outputs_(U64 key) {
+   Path entry = cache_path_ / key_string(key);
+
+   std::ifstream manifest((entry / "manifest").string());
+   if (!manifest) {
+      return false;
+   }
+
+   int cached_status = 0;
+   manifest >> cached_status;
+   manifest.ignore(1);
+
+   std::vector<Path> outputs;
+   S line;
+   while (std::getline(manifest, line)) {
+      if (!line.empty()) {
+         outputs.push_back(line);
+      }
+   }
+
+   for (std::size_t i = 0; i < outputs.size(); ++i) {
+      if (!fs::exists(entry / std::to_string(i))) {
+         be_short_verbose() << "Ignoring incomplete cache entry: " << entry.string() | default_log();
+         return false;
+      }
+   }
+
+   be_short_info() << "Restoring " << outputs.size() << " cached output files" | default_log();
+
+   for (std::size_t i = 0; i < outputs.size(); ++i) {
+      const Path& path = outputs[i];
+      if (fs::exists(path)) {
+         if (!overwrite_output_files_) {
+            set_status_(status_write_error);
+            be_error() << "Skipping ouput file: file already exists; use --overwrite to ignore."
+               & attr(ids::log_attr_output_path) << path.string()
+               | default_log();
+            continue;
+         }
+
+         std::error_code ec;
+         fs::remove(path, ec);
+      }
+
+      Path cached = entry / std::to_string(i);
+      std::error_code ec;
+      fs::create_hard_link(cached, path, ec);
+      if (ec) {
+         ec.clear();
+         fs::copy_file(cached, path, fs::copy_options::overwrite_existing, ec);
+      }
+
+      if (ec) {
+         set_status_(status_write_error);
+         log_exception(fs::filesystem_error("Error restoring cached output texture!", path, ec));
+      } else {
+         written_outputs_.push_back(path);
+         be_short_verbose() << "Restored " << path.string() | default_log();
+      }
+   }
+
+   if (cached_status > status_ok && cached_status <= status_warning) {
+      set_status_(static_cast<status_code_>(cached_status));
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::store_cached_outputs_(U64 key, const std::vector<Path>& outputs) {
+   if (outputs.empty()) {
+      return;
+   }
+
+   S name = key_string(key);
+   Path entry = cache_path_ / name;
+   if (fs::exists(entry)) {
+      return;
+   }
+
+   // Populate a uniquely named directory first, then rename it into place, so that other processes sharing the cache
+   // never see a partially written entry.
+   std::random_device rd;
+   Path temp = cache_path_ / (name + ".tmp-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "-" + std::to_string(rd()));
+
+   std::error_code ec;
+   fs::create_directories(temp, ec);
+
+   for (std::size_t i = 0; i < outputs.size() && !ec; ++i) {
+      fs::copy_file(outputs[i], temp / std::to_string(i), ec);
+   }
+
+   if (!ec) {
+      std::ofstream manifest((temp / "manifest").string());
+      manifest << int(status_) << '\n';
+      for (const Path& path : outputs) {
+         manifest << path.string() << '\n';
+      }
+      manifest.close();
+      if (!manifest) {
+         ec = std::make_error_code(std::errc::io_error);
+      }
+   }
+
+   if (!ec) {
+      fs::rename(temp, entry, ec);
+      if (ec && fs::exists(entry)) {
+         // another process stored the same entry first
+         ec.clear();
+      }
+   }
+
+   if (ec) {
+      set_status_(status_warning);
+      log_exception(fs::filesystem_error("Failed to store outputs in cache!", entry, ec));
+   }
+
+   std::error_code ignored;
+   fs::remove_all(temp, ignored);
+}
+
+} // be::atex
@@ -2,17 +2,30 @@
 #include "version.hpp"
 #include <be/gfx/version.hpp>
 #include <be/core/version.hpp>
-#include <be/core/log_exception.hpp>
 #include <be/cli/cli.hpp>
 #include <be/util/paths.hpp>
 #include <iostream>
-#include <regex>
 
 namespace be::atex {
 
 ///////////////////////////////////////////////////////////////////////////////
 AtexApp::AtexApp(int argc, char** argv) {
+   init_.emplace();
    default_log().verbosity_mask(v::info_or_worse);
+   process_cli_(argc, argv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AtexApp::AtexApp(int argc, char** argv, const AtexApp& batch)
+   : pool_(batch.pool_),
+     io_pool_(batch.io_pool_),
+     arena_(batch.arena_),
+     decode_cache_(batch.decode_cache_) {
+   process_cli_(argc, argv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::process_cli_(int argc, char** argv) {
    try {
       using namespace cli;
       using namespace color;
@@ -47,10 +60,12 @@ AtexApp::AtexApp(int argc, char** argv) {
          (summary ("Execution consists of two phases.  First, one or more input images or textures are loaded.  In the second phase, each input image/texture is "
                    "copied into a single in-memory texture, converting the texel format if necessary.  Then one or more image or texture views are written to disk.").verbose())
 
-         (summary ("Although texel format, colorspace, alpha premultiplication, and channel swizzling conversions can be performed on textures, no other operations will be performed, including "
-                   "rescaling, cropping, mipmap generation, rotation, distortion, compositing, exposure/color correction, etc.  Compressed texel formats can be converted to uncompressed texel "
-                   "formats, but compressed texel formats can only be output if the input textures are provided in the exact same compressed texel format and no colorspace or alpha "
-                   "premultiplication conversions are required.").verbose())
+         (summary (Cell() << "Although texel format, colorspace, alpha premultiplication, and channel swizzling conversions can be performed on textures, and missing mipmap levels can "
+                             "be generated with " << fg_yellow << "--gen-mips" << reset << ", no other operations will be performed, including rescaling, cropping, rotation, distortion, "
+                             "compositing, exposure/color correction, etc.  S3TC, RGTC, and BPTC unorm (BC7) compressed texel formats can be converted to any other texel format, and "
+                             "are decoded automatically when writing image files.  S3TC and RGTC compressed texel formats can be output from any input format; other compressed texel "
+                             "formats can only be output if the input textures are provided in the exact same compressed texel format and no colorspace or alpha premultiplication "
+                             "conversions are required.").verbose())
 
          (summary (Cell() << "If any input texture field types or swizzles are reinterpreted with " << fg_yellow << "--ctype-*" << reset << " or " << fg_yellow
                           << "--swizzle-*" << reset << " then they are all reinterpreted.  Field types will default to " << fg_cyan << "none" << reset
@@ -74,7 +89,7 @@ AtexApp::AtexApp(int argc, char** argv) {
                           << fg_dark_gray << ", " << fg_green << "GIF").verbose())
 
          (summary (Cell() << "Supported output texture file types: " << fg_green << "beTx"
-                          //<< fg_dark_gray << ", " << fg_green << "DDS"
+                          << fg_dark_gray << ", " << fg_green << "DDS"
                           << fg_dark_gray << ", " << fg_green << "KTX").verbose())
          (summary (Cell() << "Supported output image file types: " << fg_green << "PNG"
                           << fg_dark_gray << ", " << fg_green << "Targa"
@@ -204,12 +219,45 @@ AtexApp::AtexApp(int argc, char** argv) {
             }).when(configuring_output).desc("Specifies the texture class for output textures."))
 
          (enum_param<BlockPacking> ({ "p" }, { "packing" }, "PACKING", packing_, [](BlockPacking packing) {
-               return !is_compressed(packing);
+               return !is_compressed(packing) || can_encode(block_codec(packing));
             }, [this](BlockPacking packing) {
                override_block_ = true;
                return packing;
             }).when(configuring_output)
-              .desc("Specifies that output textures should use a custom texel format and sets the block packing for that format."))
+              .desc("Specifies that output textures should use a custom texel format and sets the block packing for that format.")
+              .extra("The S3TC and RGTC compressed block packings (BC1-BC5) may be used; images are encoded as they are merged."))
+
+         (param ({ }, { "encode-quality" }, "PRESET", [&](const S& str) {
+               if (str == "fast") {
+                  encode_quality_ = EncodeQuality::fast;
+               } else if (str == "normal") {
+                  encode_quality_ = EncodeQuality::normal;
+               } else if (str == "high") {
+                  encode_quality_ = EncodeQuality::high;
+               } else {
+                  throw std::runtime_error("Expected 'fast', 'normal', or 'high'");
+               }
+            }).when(configuring_output)
+              .desc("Sets the speed/quality tradeoff used when encoding compressed block packings.")
+              .extra(Cell() << fg_cyan << "fast" << reset << " fits each block's bounding box, " << fg_cyan << "normal" << reset
+                            << " (the default) fits each block's principal axis, and " << fg_cyan << "high" << reset
+                            << " additionally refines the endpoints by least squares and searches nearby alpha endpoints."))
+
+         (param ({ }, { "gen-mips" }, "FILTER", [&](const S& str) {
+               if (str == "box") {
+                  mipmap_filter_ = MipmapFilter::box;
+               } else if (str == "kaiser") {
+                  mipmap_filter_ = MipmapFilter::kaiser;
+               } else if (str == "lanczos") {
+                  mipmap_filter_ = MipmapFilter::lanczos;
+               } else {
+                  throw std::runtime_error("Expected 'box', 'kaiser', or 'lanczos'");
+               }
+            }).when(configuring_output)
+              .desc("Generates any mipmap levels which are not provided by an input, down to 1x1.")
+              .extra(Cell() << "Each missing level is filtered from the next larger level using " << fg_cyan << "box" << reset << " (area average), "
+                            << fg_cyan << "kaiser" << reset << ", or " << fg_cyan << "lanczos" << reset << " (windowed sinc) filtering.  Filtering is done in "
+                               "linear space with premultiplied alpha, so sRGB and straight alpha textures are converted as necessary."))
 
          (numeric_param ({ "c" }, { "components" }, "N", components_, (U8)1, (U8)4)
             .when(configuring_output).desc("Specifies the number of components when using a custom texel format."))
@@ -328,6 +376,13 @@ AtexApp::AtexApp(int argc, char** argv) {
          (flag ({ "z" }, { "compress" }, next_output.payload_compression)
             .when(configuring_output).desc("Enables optional payload compression if the next file format written supports it."))
 
+         (numeric_param<U8> ({ }, { "png-effort" }, "N", next_output.png_effort, 0, max_png_effort)
+            .when(configuring_output).desc("If the next file written is a PNG, spend more time searching for a smaller lossless encoding.")
+            .extra(Cell() << nl << "At " << fg_cyan << "0" << reset << " (the default) the PNG is written as-is.  "
+                          << fg_cyan << "1" << reset << " reduces the color type, bit depth, and palette where that is lossless.  "
+                          << fg_cyan << "2" << reset << " tries every candidate encoding with every scanline filter strategy in parallel, and "
+                          << fg_cyan << "3" << reset << " also tries several zlib strategies.  The smallest result is kept."))
+
          (enum_param<TextureFileFormat> ({ "t" }, { "type" }, "FILE_EXT", default_output_format, [](TextureFileFormat format) {
                switch (format) {
                   case TextureFileFormat::unknown:
@@ -367,6 +422,26 @@ AtexApp::AtexApp(int argc, char** argv) {
                             << " options.  Directories will be searched in the order they are specified.  If no input directories are specified, the working directory "
                                "is implicitly searched.  Directories added to the search path apply to all inputs, including those specified earlier on the command line."))
 
+         (flag ({ }, { "mmap" }, map_input_files_)
+            .desc("Memory-map input files instead of reading them into memory.")
+            .extra("Reduces peak memory usage and I/O for large uncompressed beTx and KTX inputs.  If a file cannot be mapped, it is read normally."))
+
+         (flag ({ }, { "stream" }, stream_inputs_)
+            .desc("Merge input files one at a time.")
+            .extra("The layout of the merged texture is planned from input file headers where possible, then each input is "
+                   "decoded, copied into the merged texture, and released before the next one is decoded.  This bounds peak "
+                   "memory usage to roughly the size of the merged texture plus one input, at the cost of reading some files "
+                   "twice when their layout can't be determined from the header alone (eg. beTx).  Each output file is "
+                   "written as soon as all of the images it contains have been merged."))
+
+         (flag ({ }, { "probe" }, probe_)
+            .desc("Prints the planned layout of the merged texture and the files that would be written as JSON, without writing anything.")
+            .extra(Cell() << "Only input file headers are read where possible; files whose layout can't be determined from the header (eg. beTx) are decoded.  "
+                             "The JSON is written to standard output and describes each input's format, dimensions, layers, faces, levels, and colorspace, "
+                             "the merged texture's layout, and each output file along with its uncompressed size and a relative cost estimate.  "
+                             "Costs are in the same units used to order output jobs, and are proportional to the expected time needed to write each file; "
+                             "they can be converted to milliseconds using the write throughput reported by " << fg_yellow << "--stats-json" << reset << "."))
+
          (param ({ "d" },{ "output-dir" }, "PATH", [&](const S& str) {
                if (!output_path_base_.empty()) {
                   throw std::runtime_error("An output directory has already been specified");
@@ -379,10 +454,74 @@ AtexApp::AtexApp(int argc, char** argv) {
          (flag ({ "F" }, { "overwrite" }, overwrite_output_files_)
             .desc("Overwrite output files that already exist."))
 
+         (param ({ }, { "cache" }, "PATH", [&](const S& str) {
+               cache_path_ = util::parse_path(str);
+            }).desc("Specifies a directory in which to cache output files.")
+              .extra(Cell() << nl << "The cache is keyed on the contents of every input file and all options that affect the output.  If a matching entry exists, "
+                                     "no inputs are decoded; the cached outputs are hard-linked (or copied, if linking fails) to their destinations.  "
+                                     "Outputs restored from the cache should not be modified in place.  The existing output file rules still apply; use "
+                            << fg_yellow << "--overwrite" << reset << " to replace outputs which already exist."))
+
          (numeric_param<int> ({ "Q" }, { "jpeg-quality" }, "Q", jpeg_quality_, 1, 100)
             .desc("Specifies the quality level to use when writing JPEG files.")
             .extra("Applies to all output JPEG files.  If set multiple times, only the last specified value is meaningful."))
 
+         (flag ({ }, { "profile" }, profile_)
+            .desc("Logs the time and number of bytes processed in each phase of the job.")
+            .extra("Phases are globbing input paths, reading and parsing each input file, allocating the merged texture, converting "
+                   "images, generating mipmaps, and writing each output file.  Time spent on worker threads is summed, so phase "
+                   "times may exceed the wall time."))
+
+         (param ({ }, { "stats-json" }, "PATH", [&](const S& str) {
+               stats_json_path_ = util::parse_path(str);
+            }).desc(Cell() << "Writes the statistics collected by " << fg_yellow << "--profile" << reset << " to a JSON file.")
+              .extra("In addition to per-phase totals, the file lists every recorded event (eg. each input file read) along with its "
+                     "throughput, and the peak resident memory of the process."))
+
+         (numeric_param<U16> ({ "j" }, { "jobs" }, "N", jobs_, 0, 1024)
+            .desc("Specifies the number of worker threads to use when decoding input files and encoding output files.")
+            .extra(Cell() << "If set to " << fg_cyan << "0" << reset << " one thread will be used for each hardware thread.  "
+                             "Regardless of the number of threads, inputs are merged in the order they appear on the command line, and each output file is written at most once.  "
+                             "Jobs run from a batch file share the worker pool of the batch, so this option is ignored when it appears in a batch file."))
+
+         (numeric_param<U16> ({ }, { "io-depth" }, "N", io_depth_, 0, 256)
+            .desc("Specifies how many input files may be read from disk at once, ahead of decoding.")
+            .extra(Cell() << "Defaults to " << fg_cyan << "4" << reset << ".  Reads are done by a separate set of threads, so that waiting on slow or network storage "
+                             "doesn't hold up decoding; each input is handed to the worker pool as soon as it has been read.  With " << fg_yellow << "--stream" << reset
+                          << " at most this many inputs are read ahead of the one being merged.  "
+                             "If set to " << fg_cyan << "0" << reset << " or " << fg_cyan << "1" << reset << " files are read on the main thread, or by the worker that decodes them.  "
+                             "Memory mapped inputs are not read ahead.  Jobs run from a batch file share the I/O threads of the batch, so this option is ignored when it appears in a batch file."))
+
+         (numeric_param<U32> ({ }, { "decode-cache" }, "MB", decode_cache_mb_, 0, 1 << 20)
+            .desc("Specifies how much memory may be used to keep decoded input files between jobs in batch and server mode.")
+            .extra(Cell() << "Defaults to " << fg_cyan << "256" << reset << " MiB.  When a job reads a file which is already cached, and whose size and modification time haven't changed, "
+                             "the cached texture is used instead of decoding it again.  The least recently used files are dropped once the limit is reached.  "
+                             "Input overrides are applied to each job's view of the cached texture, so they don't affect caching.  "
+                             "Cached files are never memory mapped.  If set to " << fg_cyan << "0" << reset << " nothing is cached.  "
+                             "This option is ignored when it appears in a batch file or server job."))
+
+         (param ({ }, { "batch" }, "PATH", [&](const S& str) {
+               if (pool_) {
+                  throw std::runtime_error("Batch files cannot be nested");
+               }
+               batch_path_ = str;
+            }).desc("Runs each line of the specified file as a separate atex command line.")
+              .extra(Cell() << "If " << fg_cyan << "PATH" << reset << " is " << fg_cyan << "-" << reset << " the jobs will be read from standard input.  "
+                               "Blank lines and lines beginning with " << fg_cyan << "#" << reset << " are ignored.  Arguments may be quoted with single or double quotes.  "
+                               "All jobs run in this process, one after another, sharing a single worker pool.  The exit code is the most severe exit code of any job."))
+
+         (param ({ }, { "serve" }, "SOCKET", [&](const S& str) {
+               if (pool_) {
+                  throw std::runtime_error("Server mode cannot be started from a job");
+               }
+               serve_path_ = util::parse_path(str);
+            }).desc("Listens on a local socket and runs each line received as a separate atex command line.")
+              .extra(Cell() << "Lines use the same syntax as " << fg_yellow << "--batch" << reset << " files.  The worker pool, texture memory, and decode cache are kept between jobs.  "
+                               "For each line, the server replies with one line per line of console output, prefixed with " << fg_cyan << "log" << reset
+                            << ", then one line per file written, prefixed with " << fg_cyan << "output" << reset << ", and finally " << fg_cyan << "status N" << reset
+                            << " with the job's exit code.  A connection may send any number of lines, but only one connection is served at a time.  "
+                               "Sending " << fg_cyan << ":shutdown" << reset << " stops the server."))
+
          (verbosity_param ({ "v" },{ "verbosity" }, "LEVEL", default_log().verbosity_mask()))
 
          (flag ({ "V" },{ "version" }, show_version).desc("Prints version information to standard output."))
@@ -420,7 +559,7 @@ AtexApp::AtexApp(int argc, char** argv) {
 
       proc.process(argc, argv);
 
-      if (!show_help && !show_version && input_files_.empty()) {
+      if (!show_help && !show_version && input_files_.empty() && batch_path_.empty() && serve_path_.empty()) {
          show_help = true;
          show_version = true;
          set_status_(status_no_input);
@@ -442,39 +581,28 @@ AtexApp::AtexApp(int argc, char** argv) {
          proc.describe(std::cout, verbose, ids::cli_describe_section_license);
       }
 
+      if (!batch_path_.empty() && !input_files_.empty()) {
+         throw std::runtime_error("Input files cannot be specified along with a batch file");
+      }
+
+      if (!serve_path_.empty() && (!input_files_.empty() || !batch_path_.empty())) {
+         throw std::runtime_error("Input files and batch files cannot be specified in server mode");
+      }
+
       if (!input_files_.empty() && output_files_.empty() && configuring_input()) {
          next_output.file_format = TextureFileFormat::betx;
          next_output.path = input_files_.front().path;
 
-         std::regex re("-(?:[lfm]|layer|face|level)\\d+", std::regex_constants::icase);
-         S filename = std::regex_replace(next_output.path.filename().string(), re, "");
+         S filename = strip_filename_indices(next_output.path.filename().string());
          next_output.path = next_output.path.parent_path() / filename;
          next_output.path.replace_extension("betx");
 
          output_files_.push_back(next_output);
       }
 
-   } catch (const cli::OptionError& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const cli::ArgumentError& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const FatalTrace& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const RecoverableTrace& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const fs::filesystem_error& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const std::system_error& e) {
-      set_status_(status_cli_error);
-      log_exception(e);
-   } catch (const std::exception& e) {
+   } catch (...) {
       set_status_(status_cli_error);
-      log_exception(e);
+      log_current_exception();
    }
 }
 
@@ -0,0 +1,183 @@
+#include "atex_app.hpp"
+#include "../src-tools-gfx/json_writer.hpp"
+#include <be/core/logging.hpp>
+#include <be/gfx/tex/mipmapping.hpp>
+#include <iostream>
+#include <sstream>
+
+namespace be::atex {
+namespace {
+
+using namespace be::gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void write_json_enum(std::ostream& os, T value) {
+   std::ostringstream oss;
+   oss << value;
+   write_json_string(os, oss.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t texel_count(ivec3 dim) {
+   return std::size_t(dim.x) * std::size_t(dim.y) * std::size_t(dim.z);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sizes can't be estimated when the texel size is unknown, so they're written as null rather than 0.
+template <typename T>
+void write_json_size(std::ostream& os, double texel_bytes, T value) {
+   if (texel_bytes > 0) {
+      os << value;
+   } else {
+      os << "null";
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void write_json_dim(std::ostream& os, ivec3 dim) {
+   os << "\"width\": " << dim.x << ", \"height\": " << dim.y << ", \"depth\": " << dim.z;
+}
+
+} // be::atex::()
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::run_probe_(const std::vector<input_file_>& files) {
+   merge_plan_ plan;
+   std::vector<input_> inputs;
+   std::vector<planned_input_> planned = plan_inputs_(files, plan, inputs);
+
+   const bool have_layout = !inputs.empty() && plan_layout_(plan, inputs);
+   if (!have_layout) {
+      set_status_(status_no_input);
+   }
+
+   std::vector<output_job_> jobs;
+   double texel_bytes = 0;
+   if (have_layout) {
+      jobs = plan_outputs_(plan);
+
+      // The merged format is only known exactly once the base input is decoded, so sizes are estimated from the
+      // requested block packing, or failing that, the base input's header (or decoded format, if it had no header).
+      if (override_block_) {
+         BlockCodec codec = block_codec(packing_, field_types_[0]);
+         if (codec != BlockCodec::none) {
+            texel_bytes = codec_block_size(codec) / 16.0;
+         } else {
+            texel_bytes = double(std::max<std::size_t>(block_span_, block_word_size(packing_) * block_word_count(packing_)));
+         }
+      } else {
+         const TextureHeader& header = planned[plan.base_input].header;
+         texel_bytes = header.texel_bytes;
+      }
+   }
+
+   std::ostream& os = std::cout;
+   os << "{\n  \"inputs\": [";
+   for (std::size_t i = 0; i < planned.size(); ++i) {
+      const planned_input_& input = planned[i];
+      const TextureHeader& header = input.header;
+      std::error_code ec;
+      const std::uintmax_t file_size = fs::file_size(input.file->path, ec);
+
+      os << (i == 0 ? "\n    " : ",\n    ") << "{ \"path\": ";
+      write_json_string(os, input.file->path.string());
+      os << ", \"file_format\": ";
+      write_json_enum(os, header.file_format);
+      os << ", \"file_bytes\": ";
+      if (ec) {
+         os << "null";
+      } else {
+         os << file_size;
+      }
+      os << ", \"header_only\": " << (input.header_only ? "true" : "false")
+         << ", \"texture_class\": ";
+      write_json_enum(os, header.tex_class);
+      os << ", ";
+      write_json_dim(os, header.dim);
+      os << ", \"layers\": " << header.layers
+         << ", \"faces\": " << header.faces
+         << ", \"levels\": " << header.levels
+         << ", \"components\": " << std::size_t(header.components)
+         << ", \"component_bits\": " << std::size_t(header.component_bits)
+         << ", \"floating_point\": " << (header.floating_point ? "true" : "false")
+         << ", \"texel_bytes\": ";
+      write_json_size(os, header.texel_bytes, header.texel_bytes);
+      os << ", \"colorspace\": ";
+      write_json_enum(os, header.colorspace);
+      os << ", \"dest_layer\": " << std::size_t(inputs[i].dest_layer)
+         << ", \"dest_face\": " << std::size_t(inputs[i].dest_face)
+         << ", \"dest_level\": " << std::size_t(inputs[i].dest_level)
+         << " }";
+   }
+   os << "\n  ],\n  \"texture\": ";
+
+   if (have_layout) {
+      const TextureHeader& base = planned[plan.base_input].header;
+      std::size_t bytes = 0;
+      for (std::size_t level = 0; level < plan.levels; ++level) {
+         bytes += texel_count(mipmap_dim(plan.base_dim, level));
+      }
+      bytes = std::size_t(double(bytes) * plan.layers * plan.faces * texel_bytes);
+
+      os << "{ \"texture_class\": ";
+      write_json_enum(os, plan_texture_class_(plan, base.tex_class));
+      os << ", ";
+      write_json_dim(os, plan.base_dim);
+      os << ", \"layers\": " << std::size_t(plan.layers)
+         << ", \"faces\": " << std::size_t(plan.faces)
+         << ", \"levels\": " << std::size_t(plan.levels)
+         << ", \"complete\": " << (plan.complete ? "true" : "false")
+         << ", \"generated_images\": " << plan.generated.size()
+         << ", \"colorspace\": ";
+      write_json_enum(os, override_colorspace_ ? colorspace_ : base.colorspace);
+      os << ", \"texel_bytes\": ";
+      write_json_size(os, texel_bytes, texel_bytes);
+      os << ", \"bytes\": ";
+      write_json_size(os, texel_bytes, bytes);
+      os << " }";
+   } else {
+      os << "null";
+   }
+
+   os << ",\n  \"outputs\": [";
+   for (std::size_t i = 0; i < jobs.size(); ++i) {
+      const output_job_& job = jobs[i];
+      const output_range_& range = job.range;
+
+      std::size_t bytes = 0;
+      for (std::size_t level = range.base_level; level < range.base_level + range.levels; ++level) {
+         bytes += texel_count(mipmap_dim(range.dim, level));
+      }
+      if (job.depth >= 0) {
+         bytes /= std::max<std::size_t>(1, std::size_t(mipmap_dim(range.dim, range.base_level).z));
+      }
+      bytes = std::size_t(double(bytes) * range.layers * range.faces * texel_bytes);
+
+      os << (i == 0 ? "\n    " : ",\n    ") << "{ \"path\": ";
+      write_json_string(os, job.path.string());
+      os << ", \"file_format\": ";
+      write_json_enum(os, job.file_format);
+      os << ", \"base_layer\": " << range.base_layer
+         << ", \"layers\": " << range.layers
+         << ", \"base_face\": " << range.base_face
+         << ", \"faces\": " << range.faces
+         << ", \"base_level\": " << range.base_level
+         << ", \"levels\": " << range.levels
+         << ", \"z\": ";
+      if (job.depth >= 0) {
+         os << job.depth;
+      } else {
+         os << "null";
+      }
+      os << ", \"bytes\": ";
+      write_json_size(os, texel_bytes, bytes);
+      os << ", \"cost\": ";
+      write_json_size(os, texel_bytes, output_cost_(job, bytes));
+      os << " }";
+   }
+   os << "\n  ]\n}\n";
+   os.flush();
+}
+
+} // be::atex
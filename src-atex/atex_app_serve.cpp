@@ -0,0 +1,390 @@
+#include "atex_app.hpp"
+#include <be/core/log_exception.hpp>
+#include <be/core/logging.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <afunix.h>
+#include <fcntl.h>
+#include <io.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace be::atex {
+namespace {
+
+#ifdef _WIN32
+
+using socket_type = SOCKET;
+constexpr socket_type invalid_socket = INVALID_SOCKET;
+constexpr int send_flags = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+void close_socket(socket_type s) {
+   closesocket(s);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::error_code last_socket_error() {
+   return std::error_code(WSAGetLastError(), std::system_category());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool is_interrupted(const std::error_code& ec) {
+   return ec.value() == WSAEINTR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int dup_fd(int fd) { return _dup(fd); }
+int dup2_fd(int fd, int fd2) { return _dup2(fd, fd2); }
+int close_fd(int fd) { return _close(fd); }
+int read_fd(int fd, void* buf, std::size_t size) { return _read(fd, buf, unsigned(size)); }
+int open_pipe(int fds[2]) { return _pipe(fds, 64 * 1024, _O_BINARY); }
+int stdout_fd() { return _fileno(stdout); }
+int stderr_fd() { return _fileno(stderr); }
+
+#else
+
+using socket_type = int;
+constexpr socket_type invalid_socket = -1;
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+void close_socket(socket_type s) {
+   ::close(s);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::error_code last_socket_error() {
+   return std::error_code(errno, std::generic_category());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool is_interrupted(const std::error_code& ec) {
+   return ec.value() == EINTR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int dup_fd(int fd) { return ::dup(fd); }
+int dup2_fd(int fd, int fd2) { return ::dup2(fd, fd2); }
+int close_fd(int fd) { return ::close(fd); }
+int read_fd(int fd, void* buf, std::size_t size) { return int(::read(fd, buf, size)); }
+int open_pipe(int fds[2]) { return ::pipe(fds); }
+int stdout_fd() { return STDOUT_FILENO; }
+int stderr_fd() { return STDERR_FILENO; }
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// On Windows, winsock has to be initialized before AF_UNIX sockets can be
+// created; elsewhere this does nothing.
+class SocketLibrary final {
+public:
+   SocketLibrary() {
+#ifdef _WIN32
+      WSADATA data;
+      int result = WSAStartup(MAKEWORD(2, 2), &data);
+      if (result != 0) {
+         throw std::system_error(std::error_code(result, std::system_category()), "Failed to initialize winsock");
+      }
+#endif
+   }
+   SocketLibrary(const SocketLibrary&) = delete;
+   SocketLibrary& operator=(const SocketLibrary&) = delete;
+   ~SocketLibrary() {
+#ifdef _WIN32
+      WSACleanup();
+#endif
+   }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+sockaddr_un socket_address(const Path& path) {
+   sockaddr_un addr;
+   std::memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+
+   const S str = path.string();
+   if (str.size() >= sizeof(addr.sun_path)) {
+      throw std::system_error(std::make_error_code(std::errc::filename_too_long), "Socket path is too long: " + str);
+   }
+   std::memcpy(addr.sun_path, str.c_str(), str.size());
+   return addr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+socket_type open_listener(const Path& path) {
+   const sockaddr_un addr = socket_address(path);
+
+   socket_type s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+   if (s == invalid_socket) {
+      throw std::system_error(last_socket_error(), "Failed to create socket");
+   }
+
+   std::error_code status_ec;
+   const fs::file_type type = fs::symlink_status(path, status_ec).type();
+   if (type != fs::file_type::not_found && type != fs::file_type::none) {
+      // Never delete anything but a socket, whatever else the path turns out to name.
+      if (type != fs::file_type::socket) {
+         close_socket(s);
+         throw std::system_error(std::make_error_code(std::errc::file_exists), "Path exists and is not a socket: " + path.string());
+      }
+
+      // A socket file left behind by a server that didn't shut down cleanly can be replaced, but one that is still
+      // accepting connections belongs to another server.
+      if (::connect(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0) {
+         close_socket(s);
+         throw std::system_error(std::make_error_code(std::errc::address_in_use), "Another server is listening on " + path.string());
+      }
+      close_socket(s);
+
+      std::error_code ec;
+      fs::remove(path, ec);
+
+      s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (s == invalid_socket) {
+         throw std::system_error(last_socket_error(), "Failed to create socket");
+      }
+   }
+
+   if (::bind(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+       ::listen(s, 8) != 0) {
+      std::error_code ec = last_socket_error();
+      close_socket(s);
+      throw std::system_error(ec, "Failed to listen on " + path.string());
+   }
+
+   return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool send_all(socket_type s, const S& data) {
+   const char* ptr = data.data();
+   std::size_t remaining = data.size();
+   while (remaining > 0) {
+      const auto sent = ::send(s, ptr, int(std::min<std::size_t>(remaining, 1 << 20)), send_flags);
+      if (sent <= 0) {
+         return false;
+      }
+      ptr += sent;
+      remaining -= std::size_t(sent);
+   }
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Redirects standard output and standard error into a pipe for the lifetime of
+// the object.  A thread forwards each line written to the client as it arrives,
+// so a job's console output reaches the client in the same form it would have
+// appeared on the server's console.
+class ConsoleCapture final {
+public:
+   ConsoleCapture(socket_type client, bool& connected)
+      : client_(client),
+        connected_(connected) {
+      int fds[2];
+      if (open_pipe(fds) != 0) {
+         throw std::system_error(std::error_code(errno, std::generic_category()), "Failed to create pipe");
+      }
+
+      flush_();
+      saved_out_ = dup_fd(stdout_fd());
+      saved_err_ = dup_fd(stderr_fd());
+      dup2_fd(fds[1], stdout_fd());
+      dup2_fd(fds[1], stderr_fd());
+      close_fd(fds[1]);
+
+      read_fd_ = fds[0];
+      reader_ = std::thread([this]() { forward_(); });
+   }
+
+   ConsoleCapture(const ConsoleCapture&) = delete;
+   ConsoleCapture& operator=(const ConsoleCapture&) = delete;
+
+   ~ConsoleCapture() {
+      // Restoring the original descriptors closes the last write end of the pipe, which ends the reader thread.
+      flush_();
+      dup2_fd(saved_out_, stdout_fd());
+      dup2_fd(saved_err_, stderr_fd());
+      close_fd(saved_out_);
+      close_fd(saved_err_);
+      reader_.join();
+      close_fd(read_fd_);
+   }
+
+private:
+   static void flush_() {
+      std::cout.flush();
+      std::clog.flush();
+      std::cerr.flush();
+      std::fflush(stdout);
+      std::fflush(stderr);
+   }
+
+   void forward_() {
+      // Keep draining after a failed send, so that writes to the console never block the job.
+      S line;
+      char buf[4096];
+      int n;
+      while ((n = read_fd(read_fd_, buf, sizeof(buf))) > 0) {
+         for (int i = 0; i < n; ++i) {
+            if (buf[i] == '\n') {
+               send_line_(line);
+               line.clear();
+            } else if (buf[i] != '\r') {
+               line.push_back(buf[i]);
+            }
+         }
+      }
+      if (!line.empty()) {
+         send_line_(line);
+      }
+   }
+
+   void send_line_(const S& line) {
+      if (connected_) {
+         connected_ = send_all(client_, "log " + line + "\n");
+      }
+   }
+
+   socket_type client_;
+   int read_fd_ = -1;
+   int saved_out_ = -1;
+   int saved_err_ = -1;
+   bool& connected_; // cleared if the client stops accepting data; only read once the reader has finished
+   std::thread reader_;
+};
+
+} // be::atex::()
+
+///////////////////////////////////////////////////////////////////////////////
+void AtexApp::run_serve_() {
+   init_pool_();
+   init_decode_cache_();
+   arena_ = std::make_shared<Arena>();
+
+   std::optional<SocketLibrary> library;
+   socket_type listener = invalid_socket;
+   try {
+      library.emplace();
+      listener = open_listener(serve_path_);
+   } catch (...) {
+      set_status_(status_exception);
+      log_current_exception();
+      return;
+   }
+
+   be_short_info() << "Listening for jobs on " << serve_path_.string() | default_log();
+
+   std::size_t jobs = 0;
+   bool shutdown = false;
+   while (!shutdown) {
+      socket_type client = ::accept(listener, nullptr, nullptr);
+      if (client == invalid_socket) {
+         const std::error_code ec = last_socket_error();
+         if (is_interrupted(ec)) {
+            continue;
+         }
+         set_status_(status_exception);
+         log_exception(std::system_error(ec, "Failed to accept connection"));
+         break;
+      }
+
+      be_short_verbose() << "Client connected" | default_log();
+
+      try {
+         S pending;
+         char buf[4096];
+         bool connected = true;
+         while (connected && !shutdown) {
+            std::size_t end = pending.find('\n');
+            if (end == S::npos) {
+               const auto n = ::recv(client, buf, int(sizeof(buf)), 0);
+               if (n <= 0) {
+                  break;
+               }
+               pending.append(buf, std::size_t(n));
+               continue;
+            }
+
+            S line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r') {
+               line.pop_back();
+            }
+
+            if (line == ":shutdown") {
+               shutdown = true;
+               connected = send_all(client, "status 0\n");
+               break;
+            }
+
+            std::vector<S> args;
+            try {
+               args = split_command_line_(line);
+            } catch (const std::exception& e) {
+               connected = send_all(client, "log " + S(e.what()) + "\nstatus " + std::to_string(int(status_cli_error)) + "\n");
+               continue;
+            }
+
+            if (args.empty() || args.front()[0] == '#') {
+               connected = send_all(client, "status 0\n");
+               continue;
+            }
+
+            ++jobs;
+            std::vector<Path> outputs;
+            int job_status;
+            {
+               ConsoleCapture capture(client, connected);
+               job_status = run_job_(std::move(args), &outputs);
+            }
+
+            be_short_verbose() << "Job " << jobs << " finished with status " << job_status | default_log();
+
+            S reply;
+            for (const Path& path : outputs) {
+               reply += "output " + path.string() + "\n";
+            }
+            reply += "status " + std::to_string(job_status) + "\n";
+            connected = connected && send_all(client, reply);
+         }
+      } catch (...) {
+         log_current_exception();
+      }
+
+      close_socket(client);
+      be_short_verbose() << "Client disconnected" | default_log();
+   }
+
+   close_socket(listener);
+   std::error_code ec;
+   fs::remove(serve_path_, ec);
+
+   be_short_info() << "Server stopped after " << jobs << " jobs" | default_log();
+   if (decode_cache_) {
+      be_short_verbose() << "Decode cache: " << decode_cache_->hits() << " hits, " << decode_cache_->misses() << " misses" | default_log();
+   }
+}
+
+} // be::atex
@@ -0,0 +1,126 @@
+#include "filename_indices.hpp"
+
+namespace be::atex {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+enum class token_kind_ : U8 {
+   none = 0,
+   layer,
+   face,
+   level,
+   depth
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct token_ {
+   token_kind_ kind = token_kind_::none;
+   std::size_t end = 0;
+   std::string_view digits;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+bool is_digit(char c) noexcept {
+   return c >= '0' && c <= '9';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+char to_lower(char c) noexcept {
+   return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the number of characters of keyword matched at offset, or 0.
+std::size_t match_keyword(std::string_view str, std::size_t offset, std::string_view keyword) noexcept {
+   if (str.size() - offset < keyword.size()) {
+      return 0;
+   }
+   for (std::size_t i = 0; i < keyword.size(); ++i) {
+      if (to_lower(str[offset + i]) != keyword[i]) {
+         return 0;
+      }
+   }
+   return keyword.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Matches -(?:l|layer|f|face|m|level|z|depth)\d+ at the '-' at offset.
+token_ match_token(std::string_view str, std::size_t offset) noexcept {
+   struct keyword_ {
+      std::string_view text;
+      token_kind_ kind;
+   };
+   static constexpr keyword_ keywords[] = {
+      { "l", token_kind_::layer }, { "layer", token_kind_::layer },
+      { "f", token_kind_::face },  { "face", token_kind_::face },
+      { "m", token_kind_::level }, { "level", token_kind_::level },
+      { "z", token_kind_::depth }, { "depth", token_kind_::depth },
+   };
+
+   token_ token;
+   const std::size_t start = offset + 1;
+   for (const keyword_& keyword : keywords) {
+      const std::size_t length = match_keyword(str, start, keyword.text);
+      if (length == 0) {
+         continue;
+      }
+
+      std::size_t end = start + length;
+      while (end < str.size() && is_digit(str[end])) {
+         ++end;
+      }
+
+      if (end > start + length) {
+         token.kind = keyword.kind;
+         token.end = end;
+         token.digits = str.substr(start + length, end - start - length);
+         break;
+      }
+   }
+   return token;
+}
+
+} // be::atex::()
+
+///////////////////////////////////////////////////////////////////////////////
+FilenameIndices parse_filename_indices(std::string_view filename) noexcept {
+   FilenameIndices result;
+   for (std::size_t i = filename.find('-'); i != std::string_view::npos; i = filename.find('-', i + 1)) {
+      const token_ token = match_token(filename, i);
+      std::string_view* dest = nullptr;
+      switch (token.kind) {
+         case token_kind_::layer: dest = &result.layer; break;
+         case token_kind_::face:  dest = &result.face; break;
+         case token_kind_::level: dest = &result.level; break;
+         case token_kind_::depth: dest = &result.depth; break;
+         default: break;
+      }
+
+      if (dest && dest->empty()) {
+         *dest = token.digits;
+      }
+   }
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+S strip_filename_indices(std::string_view filename) {
+   S result;
+   result.reserve(filename.size());
+
+   std::size_t copied = 0;
+   for (std::size_t i = filename.find('-'); i != std::string_view::npos; i = filename.find('-', i)) {
+      const token_ token = match_token(filename, i);
+      if (token.kind == token_kind_::none || token.kind == token_kind_::depth) {
+         ++i;
+         continue;
+      }
+
+      result.append(filename.substr(copied, i - copied));
+      copied = i = token.end;
+   }
+   result.append(filename.substr(copied));
+   return result;
+}
+
+} // be::atex
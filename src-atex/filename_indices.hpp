@@ -0,0 +1,36 @@
+#pragma once
+#ifndef BE_ATEX_FILENAME_INDICES_HPP_
+#define BE_ATEX_FILENAME_INDICES_HPP_
+
+#include <be/core/be.hpp>
+#include <string_view>
+
+namespace be::atex {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The digits of the first -lN/-layerN, -fN/-faceN, -mN/-levelN, and
+///         -zN/-depthN token in a filename, or empty views if there are none.
+///
+/// \details Views refer to the string passed to parse_filename_indices.
+struct FilenameIndices {
+   std::string_view layer;
+   std::string_view face;
+   std::string_view level;
+   std::string_view depth;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds all index tokens in a single pass.  Keywords are matched
+///         case-insensitively.
+FilenameIndices parse_filename_indices(std::string_view filename) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes every layer, face, and level token from a filename.
+///
+/// \details Depth tokens are kept, since they don't select a separate image
+///         within a texture.
+S strip_filename_indices(std::string_view filename);
+
+} // be::atex
+
+#endif
@@ -0,0 +1,202 @@
+#pragma once
+#ifndef BE_ATEX_IMAGE_SLOT_INDEX_HPP_
+#define BE_ATEX_IMAGE_SLOT_INDEX_HPP_
+
+#include <be/core/be.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace be::atex {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Identifies one image of a texture.
+struct ImageSlot {
+   std::size_t layer;
+   std::size_t face;
+   std::size_t level;
+
+   U64 key() const noexcept {
+      return (U64(layer) << 16) | (U64(face) << 8) | U64(level);
+   }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps image slots to values.
+///
+/// \details Values are stored contiguously in insertion order, which is also
+///         the iteration order.  Lookups go through a dense table covering
+///         the bounding box of all inserted slots; if that would be mostly
+///         empty, a hash table is used instead.
+template <typename T>
+class ImageSlotIndex final {
+public:
+   using iterator = typename std::vector<T>::iterator;
+   using const_iterator = typename std::vector<T>::const_iterator;
+
+   std::pair<T*, bool> insert(const ImageSlot& slot, const T& value);
+   T* find(const ImageSlot& slot) noexcept;
+   const T* find(const ImageSlot& slot) const noexcept;
+
+   void clear() noexcept;
+   std::size_t size() const noexcept { return values_.size(); }
+   bool empty() const noexcept { return values_.empty(); }
+
+   iterator begin() noexcept { return values_.begin(); }
+   iterator end() noexcept { return values_.end(); }
+   const_iterator begin() const noexcept { return values_.begin(); }
+   const_iterator end() const noexcept { return values_.end(); }
+
+private:
+   static constexpr U32 empty_slot = ~U32(0);
+   static constexpr std::size_t min_dense_slots = 4096;
+   static constexpr std::size_t max_dense_overhead = 8;
+
+   struct box_ {
+      std::size_t first[3] = { };
+      std::size_t count[3] = { };
+
+      std::size_t slots() const noexcept { return count[0] * count[1] * count[2]; }
+
+      bool contains(const ImageSlot& slot) const noexcept {
+         return slot.layer - first[0] < count[0] && slot.face - first[1] < count[1] && slot.level - first[2] < count[2];
+      }
+
+      std::size_t offset(const ImageSlot& slot) const noexcept {
+         return ((slot.layer - first[0]) * count[1] + (slot.face - first[1])) * count[2] + (slot.level - first[2]);
+      }
+   };
+
+   U32 lookup_(const ImageSlot& slot) const noexcept;
+   void grow_(const ImageSlot& slot);
+   void rebuild_dense_(const box_& bounds);
+
+   std::vector<T> values_;
+   std::vector<ImageSlot> slots_;
+   box_ bounds_;
+   std::vector<U32> dense_;
+   std::unordered_map<U64, U32> sparse_;
+   bool use_sparse_ = false;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+std::pair<T*, bool> ImageSlotIndex<T>::insert(const ImageSlot& slot, const T& value) {
+   const U32 existing = lookup_(slot);
+   if (existing != empty_slot) {
+      return std::make_pair(&values_[existing], false);
+   }
+
+   const U32 index = U32(values_.size());
+   values_.push_back(value);
+   slots_.push_back(slot);
+
+   if (use_sparse_) {
+      sparse_.emplace(slot.key(), index);
+   } else {
+      if (!bounds_.contains(slot)) {
+         grow_(slot);
+      }
+      if (use_sparse_) {
+         sparse_.emplace(slot.key(), index);
+      } else {
+         dense_[bounds_.offset(slot)] = index;
+      }
+   }
+
+   return std::make_pair(&values_.back(), true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T* ImageSlotIndex<T>::find(const ImageSlot& slot) noexcept {
+   const U32 index = lookup_(slot);
+   return index == empty_slot ? nullptr : &values_[index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+const T* ImageSlotIndex<T>::find(const ImageSlot& slot) const noexcept {
+   const U32 index = lookup_(slot);
+   return index == empty_slot ? nullptr : &values_[index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void ImageSlotIndex<T>::clear() noexcept {
+   values_.clear();
+   slots_.clear();
+   bounds_ = box_();
+   dense_.clear();
+   sparse_.clear();
+   use_sparse_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+U32 ImageSlotIndex<T>::lookup_(const ImageSlot& slot) const noexcept {
+   if (use_sparse_) {
+      auto it = sparse_.find(slot.key());
+      return it == sparse_.end() ? empty_slot : it->second;
+   }
+   return bounds_.contains(slot) ? dense_[bounds_.offset(slot)] : empty_slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Extends the dense table to cover slot.  Faces and levels only ever span a
+// handful of values, so they grow exactly; layers grow geometrically so that
+// inserting one layer at a time doesn't rebuild the table for every layer.
+template <typename T>
+void ImageSlotIndex<T>::grow_(const ImageSlot& slot) {
+   const std::size_t coords[3] = { slot.layer, slot.face, slot.level };
+   box_ bounds;
+   for (int axis = 0; axis < 3; ++axis) {
+      std::size_t first = coords[axis];
+      std::size_t last = coords[axis];
+      if (bounds_.count[axis] > 0) {
+         first = std::min(first, bounds_.first[axis]);
+         last = std::max(last, bounds_.first[axis] + bounds_.count[axis] - 1);
+      }
+
+      if (axis == 0 && bounds_.count[0] > 0 && last - first + 1 > bounds_.count[0]) {
+         const std::size_t grown = bounds_.count[0] * 2;
+         if (coords[0] < bounds_.first[0]) {
+            first = bounds_.first[0] + bounds_.count[0] > grown ? std::min(first, bounds_.first[0] + bounds_.count[0] - grown) : 0;
+         } else {
+            last = std::max(last, first + grown - 1);
+         }
+      }
+
+      bounds.first[axis] = first;
+      bounds.count[axis] = last - first + 1;
+   }
+
+   if (bounds.slots() > std::max(min_dense_slots, (values_.size() + 1) * max_dense_overhead)) {
+      use_sparse_ = true;
+      dense_.clear();
+      dense_.shrink_to_fit();
+      sparse_.reserve(values_.size());
+      for (std::size_t i = 0; i + 1 < values_.size(); ++i) {
+         sparse_.emplace(slots_[i].key(), U32(i));
+      }
+      return;
+   }
+
+   rebuild_dense_(bounds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rebuilds the table for every value except the last, which is being inserted.
+template <typename T>
+void ImageSlotIndex<T>::rebuild_dense_(const box_& bounds) {
+   bounds_ = bounds;
+   dense_.assign(bounds_.slots(), empty_slot);
+   for (std::size_t i = 0; i + 1 < values_.size(); ++i) {
+      dense_[bounds_.offset(slots_[i])] = U32(i);
+   }
+}
+
+} // be::atex
+
+#endif
@@ -1,4 +1,10 @@
 #include "concur_app.hpp"
+#include "icon_file.hpp"
+#include "icon_image.hpp"
+#include "../src-tools-gfx/exception_logging.hpp"
+#include "../src-tools-gfx/mipmap_filter.hpp"
+#include "../src-tools-gfx/png_optimizer.hpp"
+#include "../src-tools-gfx/texture_io.hpp"
 #include "version.hpp"
 #include <be/core/version.hpp>
 #include <be/cli/cli.hpp>
@@ -6,10 +12,13 @@
 #include <be/util/path_glob.hpp>
 #include <be/util/parse_numeric_string.hpp>
 #include <be/core/logging.hpp>
+#include <be/core/log_exception.hpp>
 #include <be/core/alg.hpp>
 //#include <be/gfx/read_image.hpp>
 //#include <gli/gli.hpp>
-#include <stb/stb_image.h>
+#include <glm/common.hpp>
+#include <future>
+#include <thread>
 #include <iostream>
 #include <fstream>
 
@@ -70,6 +79,13 @@ ConcurApp::ConcurApp(int argc, char** argv) {
                       << "This option must be specified before any " << fg_yellow << "-s" << reset << " flags that define output sizes.  "
                       << "The number can be either a normalized floating-point value in the range [0, 1] or an integer ratio like " << fg_cyan << "4/16"))
 
+         (numeric_param<U8> ({ }, { "png-effort" }, "N", png_effort_, 0, tools::max_png_effort)
+            .desc(Cell() << "Spend more time searching for smaller lossless encodings of PNG images.")
+            .extra(Cell() << nl << "At " << fg_cyan << "0" << reset << " (the default) each PNG is written as 8-bit RGBA with a single filtering pass.  "
+                          << fg_cyan << "1" << reset << " reduces the color type, bit depth, and palette where that is lossless.  "
+                          << fg_cyan << "2" << reset << " tries every candidate encoding with every scanline filter strategy in parallel, and "
+                          << fg_cyan << "3" << reset << " also tries several zlib strategies.  The smallest result is kept."))
+
          (param ({ "s" },{ "size" }, "DIMENSION",
             [&](const S& str) {
                U16 size = util::parse_bounded_numeric_string<U16>(str, 1, 256);
@@ -105,6 +121,15 @@ ConcurApp::ConcurApp(int argc, char** argv) {
                output_sizes_[256] = hotspot;
             }).desc("Equivalent to -SMNLX"))
 
+         (numeric_param<U16> ({ "j" }, { "jobs" }, "N", jobs_, 0, 1024)
+            .desc("Specifies the number of worker threads to use when decoding input files and encoding output images.")
+            .extra(Cell() << "If set to " << fg_cyan << "0" << reset << " (the default) one thread will be used for each hardware thread."))
+
+         (flag ({ }, { "profile" }, profile_)
+            .desc("Logs the time and number of bytes processed in each phase.")
+            .extra("Phases are reading and parsing each input file, converting inputs to linear color, resizing to each output size, "
+                   "and encoding and writing the output.  Time spent on worker threads is summed, so phase times may exceed the wall time."))
+
          (nth (0,
             [&](const S& str) {
                output_path_ = str;
@@ -174,36 +199,9 @@ ConcurApp::ConcurApp(int argc, char** argv) {
          proc.describe(std::cout, verbose, ids::cli_describe_section_license);
       }
 
-   } catch (const cli::OptionError& e) {
-      status_ = 2;
-      be_error() << S(e.what())
-         & attr(ids::log_attr_index) << e.raw_position()
-         & attr(ids::log_attr_argument) << S(e.argument())
-         & attr(ids::log_attr_option) << S(e.option())
-         | default_log();
-   } catch (const cli::ArgumentError& e) {
-      status_ = 2;
-      be_error() << S(e.what())
-         & attr(ids::log_attr_index) << e.raw_position()
-         & attr(ids::log_attr_argument) << S(e.argument())
-         | default_log();
-   } catch (const FatalTrace& e) {
-      status_ = 2;
-      be_error() << "Fatal error while parsing command line!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
-         | default_log();
-   } catch (const RecoverableTrace& e) {
-      status_ = 2;
-      be_error() << "Error while parsing command line!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
-         | default_log();
-   } catch (const std::exception& e) {
+   } catch (...) {
       status_ = 2;
-      be_error() << "Unexpected exception parsing command line!"
-         & attr(ids::log_attr_message) << S(e.what())
-         | default_log();
+      tools::log_current_exception();
    }
 }
 
@@ -217,129 +215,244 @@ int ConcurApp::operator()() {
       return status_;
    }
 
-   struct ImageData {
-      //gli::image image;
-      input_type type;
-   };
+   if (profile_) {
+      profiler_ = std::make_unique<tools::Profiler>();
+   }
 
-   std::map<U16, ImageData> images;
+   std::size_t threads = jobs_;
+   if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+   }
+   pool_ = std::make_unique<tools::WorkerPool>(threads);
 
    try {
-      for (const auto& pair : inputs_) {
-         const Path& path = pair.first;
-         if (!fs::exists(path)) {
-            status_ = 3;
-            be_error() << "Input path does not exist!"
-               & attr(ids::log_attr_path) << path
-               | default_log();
-         } else if (!fs::is_regular_file(path)) {
-            status_ = 3;
-            be_error() << "Input path is not a file!"
-               & attr(ids::log_attr_path) << path
-               | default_log();
-         }
+      run_();
+   } catch (...) {
+      status_ = 1;
+      tools::log_current_exception();
+   }
 
-         /*gli::image png_image = gfx::read_png_image(path);
-         if (!png_image.empty()) {
-            ImageData data { std::move(png_image), pair.second };
-            if (data.type == input_type::automatic) {
-               data.type = input_type::png;
-            }
-            U16 dim = (U16)min(data.image.extent().x, data.image.extent().y);
-            images.emplace(dim, std::move(data));
-         } else {
-            gli::image image = gfx::read_simple_image(path);
-            if (!image.empty()) {
-               ImageData data { std::move(image), pair.second };
-               if (data.type == input_type::automatic) {
-                  data.type = input_type::bitmap;
-               }
-               U16 dim = (U16)min(data.image.extent().x, data.image.extent().y);
-               images.emplace(dim, std::move(data));
-            } else {
-               throw Fatal("Image format not recognized!");
-            }
-         }*/
-      }
-   } catch (const fs::filesystem_error& e) {
-      status_ = 4;
-      be_error() << "Filesystem error while reading inputs!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_code) << std::error_code(e.code())
-         & attr(ids::log_attr_path) << e.path1().generic_string()
-         | default_log();
-   } catch (const FatalTrace& e) {
-      status_ = 4;
-      be_error() << "Fatal error while reading inputs!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
-         | default_log();
-   } catch (const RecoverableTrace& e) {
-      status_ = 4;
-      be_error() << "Error while reading inputs!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
+   if (profiler_) {
+      profiler_->log_summary();
+   }
+
+   return status_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ConcurApp::run_() {
+   resize_images_(load_sources_());
+
+   if (status_ != 0) {
+      return;
+   }
+
+   if (images_.empty()) {
+      status_ = 3;
+      be_error() << "No input images are large enough for any output size!"
          | default_log();
-   } catch (const std::exception& e) {
-      status_ = 4;
-      be_error() << "Unexpected exception while reading inputs!"
-         & attr(ids::log_attr_message) << S(e.what())
+      return;
+   }
+
+   output_path_ = fs::absolute(output_path_);
+   if (fs::exists(output_path_)) {
+      if (!fs::is_regular_file(output_path_)) {
+         status_ = 5;
+         be_error() << "Output path already exists and is not a file!"
+            & attr(ids::log_attr_path) << output_path_
+            | default_log();
+         return;
+      }
+   } else if (!fs::exists(output_path_.parent_path())) {
+      fs::create_directories(output_path_.parent_path());
+   }
+
+   be_short_verbose() << "Output path: " << color::fg_gray << output_path_.generic_string() | default_log();
+
+   bool cursor = output_type_ == output_type::cursor;
+   if (output_type_ == output_type::automatic) {
+      cursor = output_path_.extension() == Path(".cur");
+      for (const auto& pair : images_) {
+         cursor = cursor || pair.second.hotspot != glm::vec2();
+      }
+   }
+
+   std::vector<UC> data = assemble_icon_file(cursor, encode_images_());
+
+   tools::ProfileScope scope(profiler_.get(), tools::ProfilePhase::write, output_path_.string());
+   std::ofstream ofs(output_path_.string(), std::ios::binary | std::ios::trunc);
+   ofs.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+   ofs.close();
+   if (!ofs) {
+      status_ = 5;
+      be_error() << "Failed to write output file!"
+         & attr(ids::log_attr_path) << output_path_
          | default_log();
    }
+   scope.bytes(data.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::map<U16, ConcurApp::source_> ConcurApp::load_sources_() {
+   struct loaded_ {
+      tools::DecodedTexture decoded;
+      tools::MipmapImage image;
+      bool converted = false;
+   };
 
-   // TODO resize images
-   // TODO serialize output images
-   // TODO optimize pngs if necessary
+   // Inputs are decoded on the pool; errors are logged afterwards, in command line order.
+   std::vector<std::pair<const std::pair<const Path, input_type>*, std::future<loaded_>>> loads;
+   for (const auto& pair : inputs_) {
+      const Path& path = pair.first;
+      if (!fs::exists(path)) {
+         status_ = 3;
+         be_error() << "Input path does not exist!"
+            & attr(ids::log_attr_path) << path
+            | default_log();
+         continue;
+      } else if (!fs::is_regular_file(path)) {
+         status_ = 3;
+         be_error() << "Input path is not a file!"
+            & attr(ids::log_attr_path) << path
+            | default_log();
+         continue;
+      }
 
-   try {
-      output_path_ = fs::absolute(output_path_);
-      if (fs::exists(output_path_)) {
-         if (!fs::is_regular_file(output_path_)) {
-            status_ = 5;
-            be_error() << "Output path already exists and is not a file!"
-               & attr(ids::log_attr_path) << output_path_
-               | default_log();
+      loads.emplace_back(&pair, pool_->submit([path, profiler = profiler_.get()]() {
+         loaded_ result;
+         result.decoded = tools::read_texture_file(path, gfx::tex::TextureFileFormat::unknown, false, profiler);
+         if (!result.decoded.read_error && !result.decoded.parse_error && result.decoded.texture.view) {
+            tools::ProfileScope scope(profiler, tools::ProfilePhase::blit, path.string());
+            result.converted = tools::load_mipmap_image(result.decoded.texture.view.image(), result.image);
          }
-      } else if (!fs::exists(output_path_.parent_path())) {
-         fs::create_directories(output_path_.parent_path());
+         return result;
+      }));
+   }
+
+   std::map<U16, source_> sources;
+   for (auto& load : loads) {
+      const Path& path = load.first->first;
+      loaded_ loaded = load.second.get();
+
+      if (loaded.decoded.read_error) {
+         status_ = 4;
+         log_exception(std::system_error(loaded.decoded.read_error, "Failed to read image file: " + path.string()));
+         continue;
+      } else if (loaded.decoded.parse_error) {
+         status_ = 4;
+         log_exception(std::system_error(loaded.decoded.parse_error, "Failed to parse image file: " + path.string()));
+         continue;
+      } else if (!loaded.decoded.texture.view) {
+         status_ = 4;
+         be_error() << "Loading image file resulted in an empty image!"
+            & attr(ids::log_attr_path) << path.string()
+            | default_log();
+         continue;
+      } else if (!loaded.converted) {
+         status_ = 4;
+         be_error() << "Image file's block packing is not supported!"
+            & attr(ids::log_attr_path) << path.string()
+            | default_log();
+         continue;
       }
 
-      be_short_verbose() << "Output path: " << color::fg_gray << output_path_.generic_string() | default_log();
+      source_ source { path, load.first->second, nullptr };
+      if (source.type == input_type::automatic) {
+         source.type = loaded.decoded.file_format == gfx::tex::TextureFileFormat::png ? input_type::png : input_type::bitmap;
+      }
 
+      const glm::ivec3 image_dim = loaded.image.dim();
+      if (image_dim.x != image_dim.y) {
+         be_warn() << "Input image is not square; it will be stretched."
+            & attr(ids::log_attr_path) << path
+            & attr("Width") << image_dim.x
+            & attr("Height") << image_dim.y
+            | default_log();
+      }
 
+      U16 dim = U16(std::min(std::min(image_dim.x, image_dim.y), 0xFFFF));
+      if (sources.count(dim) != 0) {
+         be_warn() << "Another input image has the same size; ignoring this one."
+            & attr(ids::log_attr_path) << path
+            & attr("Size") << dim
+            | default_log();
+         continue;
+      }
 
+      source.chain = std::make_unique<tools::ResizeChain>(std::move(loaded.image));
+      sources.emplace(dim, std::move(source));
+   }
 
+   return sources;
+}
 
+///////////////////////////////////////////////////////////////////////////////
+void ConcurApp::resize_images_(std::map<U16, source_> sources) {
+   // Largest sizes first, so each source's chain of halved images is built once, top down.
+   for (auto it = output_sizes_.rbegin(); it != output_sizes_.rend(); ++it) {
+      const U16 size = it->first;
+      auto source = sources.lower_bound(size);
+      if (source == sources.end()) {
+         be_warn() << "No input image is large enough; skipping this size."
+            & attr("Size") << size
+            | default_log();
+         continue;
+      }
 
+      be_short_verbose() << "Resizing " << source->second.path.generic_string() << " to " << size << "x" << size | default_log();
 
-      // TODO write ico/cur
-   } catch (const fs::filesystem_error& e) {
-      status_ = 1;
-      be_error() << "Filesystem error while configuring paths!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_code) << std::error_code(e.code())
-         & attr(ids::log_attr_path) << e.path1().generic_string()
-         | default_log();
-   } catch (const FatalTrace& e) {
-      status_ = 1;
-      be_error() << "Fatal error while configuring paths!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
-         | default_log();
-   } catch (const RecoverableTrace& e) {
-      status_ = 1;
-      be_error() << "Error while configuring paths!"
-         & attr(ids::log_attr_message) << S(e.what())
-         & attr(ids::log_attr_trace) << StackTrace(e.trace())
-         | default_log();
-   } catch (const std::exception& e) {
-      status_ = 1;
-      be_error() << "Unexpected exception while configuring paths!"
-         & attr(ids::log_attr_message) << S(e.what())
-         | default_log();
+      tools::ProfileScope scope(profiler_.get(), tools::ProfilePhase::mipmap, source->second.path.string());
+      output_image_ output;
+      output.image = to_rgba8(source->second.chain->resize(glm::ivec3(size, size, 1)));
+      output.hotspot = it->second;
+      output.png = source->second.type == input_type::png;
+      scope.bytes(output.image.texels.size());
+      images_[size] = std::move(output);
    }
+}
 
-   return status_;
+///////////////////////////////////////////////////////////////////////////////
+std::vector<IconEntry> ConcurApp::encode_images_() {
+   // Deflating the larger PNGs dominates, so every size is encoded on the pool; tasks only touch their own
+   // output_image_ and report failure by throwing, so nothing is logged until all of them have finished.
+   std::vector<std::future<IconEntry>> encodes;
+   encodes.reserve(images_.size());
+   for (const auto& pair : images_) {
+      const output_image_& output = pair.second;
+      encodes.push_back(pool_->submit([&output, effort = png_effort_, pool = pool_.get(), profiler = profiler_.get()]() {
+         IconEntry entry;
+         entry.dim = output.image.dim;
+         entry.hotspot = glm::clamp(glm::ivec2(glm::round(output.hotspot * glm::vec2(entry.dim))), glm::ivec2(0), entry.dim - 1);
+
+         tools::ProfileScope scope(profiler, tools::ProfilePhase::write, std::to_string(entry.dim.x) + "x" + std::to_string(entry.dim.y));
+         if (output.png) {
+            entry.payload = tools::encode_rgba8_png(output.image.texels.data(), U32(entry.dim.x), U32(entry.dim.y), effort, pool);
+         } else {
+            entry.payload = encode_dib(output.image);
+         }
+         scope.bytes(entry.payload.size());
+         return entry;
+      }));
+   }
+
+   std::vector<IconEntry> entries;
+   entries.reserve(encodes.size());
+   std::exception_ptr exception;
+   for (auto& encode : encodes) {
+      try {
+         entries.push_back(encode.get());
+      } catch (...) {
+         if (!exception) {
+            exception = std::current_exception();
+         }
+      }
+   }
+
+   if (exception) {
+      std::rethrow_exception(exception);
+   }
+
+   return entries;
 }
 
 } // be::concur
@@ -2,9 +2,14 @@
 #ifndef BE_CONCUR_CONCUR_APP_HPP_
 #define BE_CONCUR_CONCUR_APP_HPP_
 
+#include "icon_file.hpp"
+#include "../src-tools-gfx/profiler.hpp"
+#include "../src-tools-gfx/resize_chain.hpp"
+#include "../src-tools-gfx/worker_pool.hpp"
 #include <be/core/lifecycle.hpp>
 #include <be/core/filesystem.hpp>
 #include <map>
+#include <memory>
 #include <glm/vec2.hpp>
 
 namespace be {
@@ -38,7 +43,30 @@ private:
    Path output_path_;
    output_type output_type_ = output_type::automatic;
    std::map<U16, glm::vec2> output_sizes_;
+   U8 png_effort_ = 0;
+   U16 jobs_ = 0;
+   bool profile_ = false;
 
+   std::unique_ptr<tools::Profiler> profiler_;
+   std::unique_ptr<tools::WorkerPool> pool_;
+
+   struct source_ {
+      Path path;
+      input_type type;
+      std::unique_ptr<tools::ResizeChain> chain;
+   };
+
+   struct output_image_ {
+      Rgba8Image image;
+      glm::vec2 hotspot;
+      bool png = false;
+   };
+   std::map<U16, output_image_> images_;
+
+   void run_();
+   std::map<U16, source_> load_sources_();
+   void resize_images_(std::map<U16, source_> sources);
+   std::vector<IconEntry> encode_images_();
 };
 
 } // be::concur
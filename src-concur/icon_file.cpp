@@ -0,0 +1,110 @@
+#include "icon_file.hpp"
+#include <cstring>
+
+namespace be {
+namespace concur {
+namespace {
+
+constexpr std::size_t icon_dir_size = 6;
+constexpr std::size_t icon_dir_entry_size = 16;
+constexpr std::size_t bitmap_info_header_size = 40;
+
+///////////////////////////////////////////////////////////////////////////////
+UC* put_u16_le(UC* ptr, U16 value) {
+   ptr[0] = UC(value);
+   ptr[1] = UC(value >> 8);
+   return ptr + 2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC* put_u32_le(UC* ptr, U32 value) {
+   ptr[0] = UC(value);
+   ptr[1] = UC(value >> 8);
+   ptr[2] = UC(value >> 16);
+   ptr[3] = UC(value >> 24);
+   return ptr + 4;
+}
+
+} // be::concur::()
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> encode_dib(const Rgba8Image& image) {
+   const std::size_t width = std::size_t(image.dim.x);
+   const std::size_t height = std::size_t(image.dim.y);
+   const std::size_t xor_span = width * 4;
+   const std::size_t and_span = ((width + 31) / 32) * 4;
+
+   std::vector<UC> result(bitmap_info_header_size + (xor_span + and_span) * height);
+   UC* ptr = result.data();
+   ptr = put_u32_le(ptr, U32(bitmap_info_header_size));
+   ptr = put_u32_le(ptr, U32(width));
+   ptr = put_u32_le(ptr, U32(height * 2));
+   ptr = put_u16_le(ptr, 1);  // planes
+   ptr = put_u16_le(ptr, 32); // bits per pixel
+   ptr = put_u32_le(ptr, 0);  // BI_RGB
+   ptr = put_u32_le(ptr, U32((xor_span + and_span) * height));
+   // resolution and palette fields are left zero
+
+   // Both the BGRA texels and the mask are stored bottom row first; mask bits
+   // are set for fully transparent texels and are all zero otherwise.
+   UC* xor_data = result.data() + bitmap_info_header_size;
+   UC* and_data = xor_data + xor_span * height;
+   for (std::size_t y = 0; y < height; ++y) {
+      const UC* src = image.texels.data() + (height - 1 - y) * xor_span;
+      UC* dest = xor_data + y * xor_span;
+      UC* mask = and_data + y * and_span;
+      for (std::size_t x = 0; x < width; ++x) {
+         dest[0] = src[2];
+         dest[1] = src[1];
+         dest[2] = src[0];
+         dest[3] = src[3];
+         if (src[3] == 0) {
+            mask[x >> 3] |= UC(0x80 >> (x & 7));
+         }
+         src += 4;
+         dest += 4;
+      }
+   }
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> assemble_icon_file(bool cursor, const std::vector<IconEntry>& entries) {
+   std::size_t size = icon_dir_size + icon_dir_entry_size * entries.size();
+   for (const IconEntry& entry : entries) {
+      size += entry.payload.size();
+   }
+
+   std::vector<UC> result(size);
+   UC* ptr = result.data();
+   ptr = put_u16_le(ptr, 0);
+   ptr = put_u16_le(ptr, cursor ? 2 : 1);
+   ptr = put_u16_le(ptr, U16(entries.size()));
+
+   std::size_t offset = icon_dir_size + icon_dir_entry_size * entries.size();
+   for (const IconEntry& entry : entries) {
+      // 256 pixel dimensions are stored as 0
+      *ptr++ = UC(entry.dim.x);
+      *ptr++ = UC(entry.dim.y);
+      *ptr++ = 0; // palette size
+      *ptr++ = 0;
+      if (cursor) {
+         ptr = put_u16_le(ptr, U16(entry.hotspot.x));
+         ptr = put_u16_le(ptr, U16(entry.hotspot.y));
+      } else {
+         ptr = put_u16_le(ptr, 1);  // planes
+         ptr = put_u16_le(ptr, 32); // bits per pixel
+      }
+      ptr = put_u32_le(ptr, U32(entry.payload.size()));
+      ptr = put_u32_le(ptr, U32(offset));
+
+      std::memcpy(result.data() + offset, entry.payload.data(), entry.payload.size());
+      offset += entry.payload.size();
+   }
+
+   return result;
+}
+
+} // be::concur
+} // be
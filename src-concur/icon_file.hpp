@@ -0,0 +1,31 @@
+#pragma once
+#ifndef BE_CONCUR_ICON_FILE_HPP_
+#define BE_CONCUR_ICON_FILE_HPP_
+
+#include "icon_image.hpp"
+
+namespace be {
+namespace concur {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One image in an .ico or .cur file, already encoded.
+struct IconEntry {
+   glm::ivec2 dim;
+   glm::ivec2 hotspot; // in pixels from the top left; cursors only
+   std::vector<UC> payload;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes a 32-bit BGRA DIB with a 1-bit AND mask, as stored in
+///         .ico and .cur files (no BITMAPFILEHEADER, doubled height).
+std::vector<UC> encode_dib(const Rgba8Image& image);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds a complete .ico or .cur file in a single buffer, so that it
+///         can be written with one call.
+std::vector<UC> assemble_icon_file(bool cursor, const std::vector<IconEntry>& entries);
+
+} // be::concur
+} // be
+
+#endif
@@ -0,0 +1,47 @@
+#include "icon_image.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace be {
+namespace concur {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+float linear_to_srgb(float c) {
+   return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC to_unorm8(float c) {
+   return UC(std::lround(std::min(1.f, std::max(0.f, c)) * 255.f));
+}
+
+} // be::concur::()
+
+///////////////////////////////////////////////////////////////////////////////
+Rgba8Image to_rgba8(const tools::MipmapImage& image) {
+   const glm::ivec3 dim = image.dim();
+
+   Rgba8Image result;
+   result.dim = glm::ivec2(dim.x, dim.y);
+   result.texels.resize(std::size_t(dim.x) * std::size_t(dim.y) * 4);
+
+   UC* dest = result.texels.data();
+   for (I32 y = 0; y < dim.y; ++y) {
+      const glm::vec4* src = image.line(y, 0);
+      for (I32 x = 0; x < dim.x; ++x) {
+         const glm::vec4 texel = src[x];
+         const float alpha = std::min(1.f, std::max(0.f, texel.a));
+         const float scale = alpha > 0.f ? 1.f / alpha : 0.f;
+         dest[0] = to_unorm8(linear_to_srgb(std::min(1.f, texel.r * scale)));
+         dest[1] = to_unorm8(linear_to_srgb(std::min(1.f, texel.g * scale)));
+         dest[2] = to_unorm8(linear_to_srgb(std::min(1.f, texel.b * scale)));
+         dest[3] = to_unorm8(alpha);
+         dest += 4;
+      }
+   }
+   return result;
+}
+
+} // be::concur
+} // be
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef BE_CONCUR_ICON_IMAGE_HPP_
+#define BE_CONCUR_ICON_IMAGE_HPP_
+
+#include "../src-tools-gfx/mipmap_filter.hpp"
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace be {
+namespace concur {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An 8-bit sRGB image with straight (non-premultiplied) alpha; the
+///         texel layout is RGBA, top row first.
+struct Rgba8Image {
+   glm::ivec2 dim;
+   std::vector<UC> texels;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the first plane of a linear, premultiplied image to the
+///         8-bit form stored in icons and cursors.
+Rgba8Image to_rgba8(const tools::MipmapImage& image);
+
+} // be::concur
+} // be
+
+#endif
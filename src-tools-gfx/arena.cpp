@@ -0,0 +1,189 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace be::tools {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t align_up(std::size_t value, std::size_t alignment) {
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+#ifdef _WIN32
+
+///////////////////////////////////////////////////////////////////////////////
+// Large pages require SeLockMemoryPrivilege, which tools don't normally run
+// with, so blocks are only aligned to the allocation granularity here.
+UC* allocate_pages(std::size_t size) {
+   void* data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+   if (data == nullptr) {
+      throw std::bad_alloc();
+   }
+   return static_cast<UC*>(data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void free_pages(UC* data, std::size_t) {
+   VirtualFree(data, 0, MEM_RELEASE);
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////
+UC* allocate_pages(std::size_t size) {
+   // Over-allocate so the block can be aligned to a huge page boundary, then return the slop on either side.
+   const std::size_t mapped_size = size + Arena::huge_page_size;
+   void* mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (mapped == MAP_FAILED) {
+      throw std::bad_alloc();
+   }
+
+   UC* begin = static_cast<UC*>(mapped);
+   UC* data = reinterpret_cast<UC*>(align_up(reinterpret_cast<std::uintptr_t>(begin), Arena::huge_page_size));
+   if (data > begin) {
+      ::munmap(begin, std::size_t(data - begin));
+   }
+   UC* end = data + size;
+   UC* mapped_end = begin + mapped_size;
+   if (mapped_end > end) {
+      ::munmap(end, std::size_t(mapped_end - end));
+   }
+
+#ifdef MADV_HUGEPAGE
+   ::madvise(data, size, MADV_HUGEPAGE);
+#endif
+
+   return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void free_pages(UC* data, std::size_t size) {
+   ::munmap(data, size);
+}
+
+#endif
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+Arena::~Arena() {
+   for (const block_& block : blocks_) {
+      free_pages(block.data, block.size);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC* Arena::allocate(std::size_t size, std::size_t alignment) {
+   return allocate_(size, alignment, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC* Arena::allocate_zeroed(std::size_t size, std::size_t alignment) {
+   return allocate_(size, alignment, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC* Arena::allocate_(std::size_t size, std::size_t alignment, bool zero) {
+   size = std::max<std::size_t>(size, 1);
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   // Freshly mapped pages are already zero, so only memory below a block's high water mark needs to be cleared.
+   auto take = [zero](block_& block, std::size_t offset, std::size_t size) {
+      if (zero && offset < block.high_water) {
+         std::memset(block.data + offset, 0, std::min(block.high_water, offset + size) - offset);
+      }
+      block.used = offset + size;
+      block.high_water = std::max(block.high_water, block.used);
+      block.touched = true;
+      return block.data + offset;
+   };
+
+   if (size >= huge_page_size) {
+      // Reuse a free dedicated block if one is large enough without wasting more than half of it.
+      for (block_& block : blocks_) {
+         if (block.dedicated && block.used == 0 && block.size >= size && block.size / 2 <= size) {
+            return take(block, 0, size);
+         }
+      }
+      return allocate_block_(size, true);
+   }
+
+   for (block_& block : blocks_) {
+      if (!block.dedicated) {
+         const std::size_t offset = align_up(block.used, alignment);
+         if (offset + size <= block.size) {
+            return take(block, offset, size);
+         }
+      }
+   }
+
+   return allocate_block_(size, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Arena::reset() {
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = std::remove_if(blocks_.begin(), blocks_.end(), [](block_& block) {
+      if (!block.touched) {
+         free_pages(block.data, block.size);
+         return true;
+      }
+      block.used = 0;
+      block.touched = false;
+      return false;
+   });
+   blocks_.erase(it, blocks_.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t Arena::capacity() const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::size_t size = 0;
+   for (const block_& block : blocks_) {
+      size += block.size;
+   }
+   return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC* Arena::allocate_block_(std::size_t size, bool dedicated) {
+   const std::size_t block_size = align_up(size, huge_page_size);
+   blocks_.reserve(blocks_.size() + 1);
+   UC* data = allocate_pages(block_size);
+   blocks_.push_back(block_ { data, block_size, size, size, dedicated, true });
+   return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::unique_ptr<gfx::tex::TextureStorage> make_texture_storage(Arena* arena, std::size_t layers, std::size_t faces, std::size_t levels, ivec3 dim,
+                                                               gfx::tex::ImageFormat::block_dim_type block_dim, U8 block_span,
+                                                               gfx::tex::TextureAlignment alignment) {
+   using gfx::tex::TextureStorage;
+   if (!arena) {
+      return std::make_unique<TextureStorage>(layers, faces, levels, dim, block_dim, block_span, alignment);
+   }
+
+   // Cleared like heap allocated storage, so images missing from a merge and alignment padding don't leak data from
+   // earlier jobs into output files.
+   const std::size_t size = TextureStorage::calculate_required_size(layers, faces, levels, dim, block_dim, block_span, alignment);
+   const U8 alignment_bits = std::max({ alignment.line(), alignment.plane(), alignment.level(), alignment.face(), alignment.layer() });
+   UC* data = arena->allocate_zeroed(size, std::max(alignof(std::max_align_t), std::size_t(1) << alignment_bits));
+   return std::make_unique<TextureStorage>(layers, faces, levels, dim, block_dim, block_span, tmp_buf(data, size), alignment);
+}
+
+} // be::tools
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_ARENA_HPP_
+#define BE_TOOLS_GFX_ARENA_HPP_
+
+#include <be/core/be.hpp>
+#include <be/gfx/tex/texture.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands out memory for texture payloads and file buffers from large
+///         page-allocated blocks which are only released all at once.
+///
+/// \details Allocations may be made from any thread.  reset() makes every
+///         block available for reuse, so a series of similar jobs keeps using
+///         the same memory instead of going back to the heap each time; blocks
+///         that weren't needed at all since the previous reset are returned
+///         to the OS.  Allocations of at least huge_page_size get a block of
+///         their own, aligned to huge_page_size so that the OS can back it
+///         with huge pages where that's supported.  Throws std::bad_alloc if
+///         a block can't be allocated.
+class Arena final {
+public:
+   static constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+   Arena() = default;
+   Arena(const Arena&) = delete;
+   Arena& operator=(const Arena&) = delete;
+   ~Arena();
+
+   UC* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+   UC* allocate_zeroed(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+   void reset();
+
+   std::size_t capacity() const;
+
+private:
+   struct block_ {
+      UC* data;
+      std::size_t size;
+      std::size_t used;
+      std::size_t high_water;
+      bool dedicated;
+      bool touched;
+   };
+
+   UC* allocate_(std::size_t size, std::size_t alignment, bool zero);
+   UC* allocate_block_(std::size_t size, bool dedicated);
+
+   mutable std::mutex mutex_;
+   std::vector<block_> blocks_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a TextureStorage whose payload is allocated from arena, or
+///         from the heap if arena is null.
+///
+/// \details The storage doesn't own arena memory, so it must be destroyed
+///         before the arena is reset.
+std::unique_ptr<gfx::tex::TextureStorage> make_texture_storage(Arena* arena, std::size_t layers, std::size_t faces, std::size_t levels, ivec3 dim,
+                                                               gfx::tex::ImageFormat::block_dim_type block_dim, U8 block_span,
+                                                               gfx::tex::TextureAlignment alignment);
+
+} // be::tools
+
+#endif
@@ -0,0 +1,336 @@
+#include "blit_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace be::tools {
+namespace {
+
+using namespace gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+// For each destination field, the source field it's copied from, or -1 if
+// it's set to a constant instead.
+struct field_map_ {
+   int source[4] = { -1, -1, -1, -1 };
+   U32 constant[4] = { };
+   bool identity = false;
+};
+
+using line_kernel = void (*)(const UC* src, std::size_t src_span, UC* dest, std::size_t dest_span, std::size_t count, const field_map_& map);
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, int SrcFields, int DestFields>
+void permute_line(const UC* src, std::size_t src_span, UC* dest, std::size_t dest_span, std::size_t count, const field_map_& map) {
+   if constexpr (SrcFields == DestFields) {
+      if (map.identity && src_span == sizeof(T) * SrcFields && dest_span == sizeof(T) * DestFields) {
+         std::memcpy(dest, src, count * src_span);
+         return;
+      }
+   }
+
+   T constants[DestFields];
+   int source[DestFields];
+   for (int f = 0; f < DestFields; ++f) {
+      constants[f] = T(map.constant[f]);
+      source[f] = map.source[f];
+   }
+
+   for (std::size_t i = 0; i < count; ++i, src += src_span, dest += dest_span) {
+      T in[SrcFields];
+      T out[DestFields];
+      std::memcpy(in, src, sizeof(in));
+      for (int f = 0; f < DestFields; ++f) {
+         out[f] = source[f] >= 0 ? in[source[f]] : constants[f];
+      }
+      std::memcpy(dest, out, sizeof(out));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Exact for all inputs, including denormals, infinities, and NaNs.
+U32 half_to_float_bits(U16 h) {
+   constexpr U32 shifted_exp = 0x7C00u << 13;
+   U32 bits = U32(h & 0x7FFFu) << 13;
+   const U32 exp = bits & shifted_exp;
+   bits += (127u - 15u) << 23;
+
+   if (exp == shifted_exp) {
+      bits += (128u - 16u) << 23;
+   } else if (exp == 0) {
+      bits += 1u << 23;
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      const U32 magic_bits = 113u << 23;
+      float magic;
+      std::memcpy(&magic, &magic_bits, sizeof(magic));
+      value -= magic;
+      std::memcpy(&bits, &value, sizeof(bits));
+   }
+
+   return bits | (U32(h & 0x8000u) << 16);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <int SrcFields, int DestFields>
+void half_to_float_line(const UC* src, std::size_t src_span, UC* dest, std::size_t dest_span, std::size_t count, const field_map_& map) {
+   for (std::size_t i = 0; i < count; ++i, src += src_span, dest += dest_span) {
+      U16 in[SrcFields];
+      U32 out[DestFields];
+      std::memcpy(in, src, sizeof(in));
+      for (int f = 0; f < DestFields; ++f) {
+         out[f] = map.source[f] >= 0 ? half_to_float_bits(in[map.source[f]]) : map.constant[f];
+      }
+      std::memcpy(dest, out, sizeof(out));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+enum class kernel_kind_ : U8 {
+   permute_8 = 0,
+   permute_16,
+   permute_32,
+   half_to_float,
+   count
+};
+
+///////////////////////////////////////////////////////////////////////////////
+template <int SrcFields, int DestFields>
+line_kernel kernel_for(kernel_kind_ kind) {
+   switch (kind) {
+      case kernel_kind_::permute_8:  return permute_line<U8, SrcFields, DestFields>;
+      case kernel_kind_::permute_16: return permute_line<U16, SrcFields, DestFields>;
+      case kernel_kind_::permute_32: return permute_line<U32, SrcFields, DestFields>;
+      default:                       return half_to_float_line<SrcFields, DestFields>;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <int SrcFields>
+void fill_kernels(line_kernel (&table)[4][4], kernel_kind_ kind) {
+   table[SrcFields - 1][0] = kernel_for<SrcFields, 1>(kind);
+   table[SrcFields - 1][1] = kernel_for<SrcFields, 2>(kind);
+   table[SrcFields - 1][2] = kernel_for<SrcFields, 3>(kind);
+   table[SrcFields - 1][3] = kernel_for<SrcFields, 4>(kind);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Indexed by kernel kind, then source and destination field counts.
+struct kernel_table_ {
+   line_kernel kernels[std::size_t(kernel_kind_::count)][4][4] = { };
+
+   kernel_table_() {
+      for (std::size_t k = 0; k < std::size_t(kernel_kind_::count); ++k) {
+         fill_kernels<1>(kernels[k], kernel_kind_(k));
+         fill_kernels<2>(kernels[k], kernel_kind_(k));
+         fill_kernels<3>(kernels[k], kernel_kind_(k));
+         fill_kernels<4>(kernels[k], kernel_kind_(k));
+      }
+   }
+};
+
+const kernel_table_ kernel_table;
+
+///////////////////////////////////////////////////////////////////////////////
+struct simple_layout_ {
+   std::size_t bytes = 0;
+   int fields = 0;
+   FieldType type = FieldType::none;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Describes formats where each texel is 1-4 fields of the same size and type.
+bool simple_layout(const ImageFormat& format, simple_layout_& layout) {
+   switch (format.packing()) {
+      case BlockPacking::s_8:           layout.bytes = 1; layout.fields = 1; break;
+      case BlockPacking::s_8_8:         layout.bytes = 1; layout.fields = 2; break;
+      case BlockPacking::s_8_8_8:       layout.bytes = 1; layout.fields = 3; break;
+      case BlockPacking::s_8_8_8_8:     layout.bytes = 1; layout.fields = 4; break;
+      case BlockPacking::s_16:          layout.bytes = 2; layout.fields = 1; break;
+      case BlockPacking::s_16_16:       layout.bytes = 2; layout.fields = 2; break;
+      case BlockPacking::s_16_16_16:    layout.bytes = 2; layout.fields = 3; break;
+      case BlockPacking::s_16_16_16_16: layout.bytes = 2; layout.fields = 4; break;
+      case BlockPacking::s_32:          layout.bytes = 4; layout.fields = 1; break;
+      case BlockPacking::s_32_32:       layout.bytes = 4; layout.fields = 2; break;
+      case BlockPacking::s_32_32_32:    layout.bytes = 4; layout.fields = 3; break;
+      case BlockPacking::s_32_32_32_32: layout.bytes = 4; layout.fields = 4; break;
+      default:
+         return false;
+   }
+
+   if (format.block_dim() != ImageFormat::block_dim_type(1) || format.block_size() < layout.bytes * layout.fields) {
+      return false;
+   }
+
+   layout.type = format.field_type(0);
+   for (int f = 1; f < layout.fields; ++f) {
+      if (format.field_type(f) != layout.type) {
+         return false;
+      }
+   }
+
+   return layout.type != FieldType::none && layout.type != FieldType::expo;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The bit pattern a field gets for Swizzle::one.
+U32 one_bits(FieldType type, std::size_t bytes) {
+   switch (type) {
+      case FieldType::unorm:
+         return bytes >= 4 ? ~U32(0) : (U32(1) << (8 * bytes)) - 1;
+      case FieldType::snorm:
+         return (U32(1) << (8 * bytes - 1)) - 1;
+      case FieldType::ufloat:
+      case FieldType::sfloat:
+         return bytes == 2 ? 0x3C00u : 0x3F800000u;
+      default:
+         return 1;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool find_kernel(const ImageFormat& src_format, const ImageFormat& dest_format, line_kernel& kernel, field_map_& map) {
+   simple_layout_ src;
+   simple_layout_ dest;
+   if (!simple_layout(src_format, src) || !simple_layout(dest_format, dest) ||
+       src_format.colorspace() != dest_format.colorspace() ||
+       src_format.premultiplied() != dest_format.premultiplied()) {
+      return false;
+   }
+
+   kernel_kind_ kind;
+   if (src.bytes == dest.bytes && src.type == dest.type) {
+      kind = src.bytes == 1 ? kernel_kind_::permute_8 : src.bytes == 2 ? kernel_kind_::permute_16 : kernel_kind_::permute_32;
+   } else if (src.bytes == 2 && dest.bytes == 4 && src.type == FieldType::sfloat && dest.type == FieldType::sfloat) {
+      kind = kernel_kind_::half_to_float;
+   } else {
+      return false;
+   }
+
+   // Each destination field takes the value of the channel it's swizzled to, which comes from either a source field
+   // or a constant, according to the source swizzles.
+   map.identity = src.fields == dest.fields;
+   for (int f = 0; f < dest.fields; ++f) {
+      int channel = -1;
+      for (int c = 0; c < 4 && channel < 0; ++c) {
+         if (dest_format.swizzle(c) == Swizzle(U8(Swizzle::field_zero) + f)) {
+            channel = c;
+         }
+      }
+      if (channel < 0) {
+         return false;
+      }
+
+      const Swizzle swizzle = src_format.swizzle(channel);
+      if (swizzle == Swizzle::zero) {
+         map.source[f] = -1;
+         map.constant[f] = 0;
+      } else if (swizzle == Swizzle::one) {
+         map.source[f] = -1;
+         map.constant[f] = one_bits(dest.type, dest.bytes);
+      } else {
+         const int field = int(U8(swizzle) - U8(Swizzle::field_zero));
+         if (field < 0 || field >= src.fields) {
+            return false;
+         }
+         map.source[f] = field;
+      }
+      map.identity = map.identity && map.source[f] == f;
+   }
+
+   kernel = kernel_table.kernels[std::size_t(kind)][src.fields - 1][dest.fields - 1];
+   return kernel != nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The smallest number of lines or planes whose combined span is a multiple of
+// the cache line size.
+I32 tile_granularity(std::size_t span) {
+   constexpr std::size_t cache_line_size = 64;
+   if (span == 0) {
+      return 1;
+   }
+   return I32(cache_line_size / std::gcd(span, cache_line_size));
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+bool blit_specialized(const ConstImageView& src, ivec3 src_offset, const ImageView& dest, ivec3 dest_offset, ivec3 dim) {
+   line_kernel kernel;
+   field_map_ map;
+   if (!find_kernel(src.format(), dest.format(), kernel, map)) {
+      return false;
+   }
+
+   if (dim.x <= 0 || dim.y <= 0 || dim.z <= 0) {
+      return true;
+   }
+
+   const std::size_t src_span = src.block_span();
+   const std::size_t dest_span = dest.block_span();
+   for (I32 z = 0; z < dim.z; ++z) {
+      const UC* src_line = src.data() + (src_offset.z + z) * src.plane_span() + src_offset.y * src.line_span() + src_offset.x * src_span;
+      UC* dest_line = dest.data() + (dest_offset.z + z) * dest.plane_span() + dest_offset.y * dest.line_span() + dest_offset.x * dest_span;
+      for (I32 y = 0; y < dim.y; ++y) {
+         kernel(src_line, src_span, dest_line, dest_span, std::size_t(dim.x), map);
+         src_line += src.line_span();
+         dest_line += dest.line_span();
+      }
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void blit_texels(const ConstImageView& src, ivec3 src_offset, const ImageView& dest, ivec3 dest_offset, ivec3 dim) {
+   if (!blit_specialized(src, src_offset, dest, dest_offset, dim)) {
+      blit_pixels(src, ImageRegion(ibox { src_offset, dim }), dest, ImageRegion(ibox { dest_offset, dim }));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<ibox> split_blit(const ImageView& dest, ivec3 dest_offset, ivec3 dim, std::size_t max_tiles, std::size_t min_tile_bytes) {
+   std::vector<ibox> tiles;
+   if (dim.x <= 0 || dim.y <= 0 || dim.z <= 0) {
+      return tiles;
+   }
+
+   const int axis = dim.z > 1 ? 2 : 1;
+   const std::size_t slice_bytes = axis == 2 ? dest.plane_span() : dest.line_span();
+   const I32 slices = dim[axis];
+   const std::size_t total_bytes = slice_bytes * std::size_t(slices);
+
+   std::size_t count = std::min(max_tiles, min_tile_bytes > 0 ? total_bytes / min_tile_bytes : max_tiles);
+   count = std::min(count, std::size_t(slices));
+   if (count <= 1) {
+      tiles.push_back(ibox { dest_offset, dim });
+      return tiles;
+   }
+
+   // Boundaries are rounded to multiples of the granularity measured from the start of the image, not the box, since
+   // that's what the image's alignment applies to.
+   const I32 granularity = tile_granularity(slice_bytes);
+   const I32 first = dest_offset[axis];
+   const I32 last = first + slices;
+   const I32 step = std::max(granularity, (slices / I32(count) + granularity - 1) / granularity * granularity);
+
+   I32 begin = first;
+   while (begin < last) {
+      I32 end = (begin / step + 1) * step;
+      if (last - end < step / 2) {
+         end = last;
+      }
+      end = std::min(end, last);
+
+      ibox tile { dest_offset, dim };
+      tile.offset[axis] = begin;
+      tile.dim[axis] = end - begin;
+      tiles.push_back(tile);
+      begin = end;
+   }
+
+   return tiles;
+}
+
+} // be::tools
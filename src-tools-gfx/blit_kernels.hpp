@@ -0,0 +1,39 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_BLIT_KERNELS_HPP_
+#define BE_TOOLS_GFX_BLIT_KERNELS_HPP_
+
+#include <be/gfx/tex/blit_pixels.hpp>
+#include <be/gfx/tex/texture.hpp>
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies a box of texels between two uncompressed images with a
+///         specialized kernel, if one exists for the pair of formats.
+///
+/// \details Kernels exist for channel reordering, adding or dropping
+///         channels, and widening half floats to floats, between formats
+///         with the same colorspace and premultiplication.  Returns false
+///         without touching dest if there is no kernel for the formats.
+bool blit_specialized(const gfx::tex::ConstImageView& src, ivec3 src_offset, const gfx::tex::ImageView& dest, ivec3 dest_offset, ivec3 dim);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies a box of texels using blit_specialized if possible, or
+///         blit_pixels otherwise.
+void blit_texels(const gfx::tex::ConstImageView& src, ivec3 src_offset, const gfx::tex::ImageView& dest, ivec3 dest_offset, ivec3 dim);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Splits a box of texels into at most max_tiles boxes which can be
+///         blitted into dest concurrently.
+///
+/// \details Volumes are split into slabs of whole planes and other images
+///         into bands of whole lines.  Tile boundaries fall on cache line
+///         boundaries of dest where its line and plane spans allow it, so
+///         that tiles written by different threads don't share lines.
+///         Boxes smaller than min_tile_bytes are never split.
+std::vector<ibox> split_blit(const gfx::tex::ImageView& dest, ivec3 dest_offset, ivec3 dim, std::size_t max_tiles, std::size_t min_tile_bytes);
+
+} // be::tools
+
+#endif
@@ -0,0 +1,1005 @@
+#include "block_codec.hpp"
+#include "blit_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace be::tools {
+namespace {
+
+using namespace gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+U16 pack_565(vec3 c) {
+   int r = glm::clamp(int(c.r * (31.f / 255.f) + 0.5f), 0, 31);
+   int g = glm::clamp(int(c.g * (63.f / 255.f) + 0.5f), 0, 63);
+   int b = glm::clamp(int(c.b * (31.f / 255.f) + 0.5f), 0, 31);
+   return U16((r << 11) | (g << 5) | b);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vec3 unpack_565(U16 c) {
+   int r = (c >> 11) & 31;
+   int g = (c >> 5) & 63;
+   int b = c & 31;
+   return vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+float distance2(vec3 a, vec3 b) {
+   vec3 d = a - b;
+   return glm::dot(d, d);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void write_le(UC* dest, U64 value, std::size_t bytes) {
+   for (std::size_t i = 0; i < bytes; ++i) {
+      dest[i] = UC(value >> (8 * i));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Chooses initial endpoints for a set of colors.  The fast preset uses the
+// bounding box; the others use the principal axis of the colors, which fits
+// gradients much better.  Both are inset slightly, since the extremes are
+// rarely the best endpoints once quantized.
+void find_color_endpoints(const vec3* colors, std::size_t n, EncodeQuality quality, vec3& hi, vec3& lo) {
+   vec3 min_color = colors[0];
+   vec3 max_color = colors[0];
+   vec3 mean = vec3(0);
+   for (std::size_t i = 0; i < n; ++i) {
+      min_color = glm::min(min_color, colors[i]);
+      max_color = glm::max(max_color, colors[i]);
+      mean += colors[i];
+   }
+   mean /= float(n);
+
+   if (quality == EncodeQuality::fast) {
+      hi = max_color;
+      lo = min_color;
+   } else {
+      float cov[6] = { };
+      for (std::size_t i = 0; i < n; ++i) {
+         vec3 d = colors[i] - mean;
+         cov[0] += d.r * d.r;
+         cov[1] += d.r * d.g;
+         cov[2] += d.r * d.b;
+         cov[3] += d.g * d.g;
+         cov[4] += d.g * d.b;
+         cov[5] += d.b * d.b;
+      }
+
+      vec3 axis = max_color - min_color;
+      for (int iteration = 0; iteration < 8; ++iteration) {
+         vec3 next = vec3(cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                          cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                          cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+         float length = glm::length(next);
+         if (length < 1e-6f) {
+            break;
+         }
+         axis = next / length;
+      }
+
+      float length = glm::length(axis);
+      if (length < 1e-6f) {
+         hi = lo = mean;
+         return;
+      }
+      axis /= length;
+
+      float min_t = 0;
+      float max_t = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+         float t = glm::dot(colors[i] - mean, axis);
+         min_t = std::min(min_t, t);
+         max_t = std::max(max_t, t);
+      }
+
+      hi = mean + axis * max_t;
+      lo = mean + axis * min_t;
+   }
+
+   vec3 inset = (hi - lo) * (1.f / 16.f);
+   hi = glm::clamp(hi - inset, vec3(0), vec3(255));
+   lo = glm::clamp(lo + inset, vec3(0), vec3(255));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct color_block_ {
+   U16 c0 = 0;
+   U16 c1 = 0;
+   U8 indices[16] = { };
+   float error = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Orders the endpoints for the requested mode, then picks the closest palette
+// entry for each texel.  In three color mode, index 3 is transparent black.
+void fit_color_block(const vec3 (&colors)[16], const bool (&transparent)[16], bool four_color, U16 a, U16 b, color_block_& block) {
+   if (four_color ? a < b : a > b) {
+      std::swap(a, b);
+   }
+
+   vec3 palette[4];
+   palette[0] = unpack_565(a);
+   palette[1] = unpack_565(b);
+   std::size_t palette_size;
+   if (four_color && a != b) {
+      palette[2] = (palette[0] * 2.f + palette[1]) * (1.f / 3.f);
+      palette[3] = (palette[0] + palette[1] * 2.f) * (1.f / 3.f);
+      palette_size = 4;
+   } else {
+      palette[2] = (palette[0] + palette[1]) * 0.5f;
+      palette_size = 3;
+   }
+
+   block.c0 = a;
+   block.c1 = b;
+   block.error = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      if (transparent[i]) {
+         block.indices[i] = 3;
+         continue;
+      }
+
+      U8 best = 0;
+      float best_error = distance2(colors[i], palette[0]);
+      for (std::size_t p = 1; p < palette_size; ++p) {
+         float error = distance2(colors[i], palette[p]);
+         if (error < best_error) {
+            best = U8(p);
+            best_error = error;
+         }
+      }
+      block.indices[i] = best;
+      block.error += best_error;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Solves for the endpoints which minimize the squared error of the current
+// index assignment.
+bool refine_color_endpoints(const vec3 (&colors)[16], const bool (&transparent)[16], const color_block_& block, bool four_color, vec3& hi, vec3& lo) {
+   static const float four_weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+   static const float three_weights[4] = { 1.f, 0.f, 0.5f, 0.f };
+   const float* weights = four_color && block.c0 != block.c1 ? four_weights : three_weights;
+
+   float alpha2 = 0;
+   float beta2 = 0;
+   float alphabeta = 0;
+   vec3 alphax = vec3(0);
+   vec3 betax = vec3(0);
+   for (std::size_t i = 0; i < 16; ++i) {
+      if (transparent[i]) {
+         continue;
+      }
+      float w = weights[block.indices[i]];
+      alpha2 += w * w;
+      beta2 += (1 - w) * (1 - w);
+      alphabeta += w * (1 - w);
+      alphax += colors[i] * w;
+      betax += colors[i] * (1 - w);
+   }
+
+   float det = alpha2 * beta2 - alphabeta * alphabeta;
+   if (std::abs(det) < 1e-6f) {
+      return false;
+   }
+
+   hi = glm::clamp((alphax * beta2 - betax * alphabeta) / det, vec3(0), vec3(255));
+   lo = glm::clamp((betax * alpha2 - alphax * alphabeta) / det, vec3(0), vec3(255));
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_color_block(const UC (&texels)[16][4], bool use_alpha, bool force_four_color, EncodeQuality quality, UC* dest) {
+   vec3 colors[16];
+   bool transparent[16];
+   vec3 opaque[16];
+   std::size_t opaque_count = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      colors[i] = vec3(texels[i][0], texels[i][1], texels[i][2]);
+      transparent[i] = use_alpha && texels[i][3] < 128;
+      if (!transparent[i]) {
+         opaque[opaque_count++] = colors[i];
+      }
+   }
+
+   color_block_ block;
+   if (opaque_count == 0) {
+      std::fill(std::begin(block.indices), std::end(block.indices), U8(3));
+   } else {
+      bool four_color = force_four_color || opaque_count == 16;
+
+      vec3 hi, lo;
+      find_color_endpoints(opaque, opaque_count, quality, hi, lo);
+      fit_color_block(colors, transparent, four_color, pack_565(hi), pack_565(lo), block);
+
+      if (quality == EncodeQuality::high) {
+         for (int iteration = 0; iteration < 2 && block.error > 0; ++iteration) {
+            if (!refine_color_endpoints(colors, transparent, block, four_color, hi, lo)) {
+               break;
+            }
+            color_block_ refined;
+            fit_color_block(colors, transparent, four_color, pack_565(hi), pack_565(lo), refined);
+            if (refined.error >= block.error) {
+               break;
+            }
+            block = refined;
+         }
+      }
+   }
+
+   U32 indices = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      indices |= U32(block.indices[i]) << (2 * i);
+   }
+
+   write_le(dest, block.c0, 2);
+   write_le(dest + 2, block.c1, 2);
+   write_le(dest + 4, indices, 4);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct alpha_block_ {
+   U8 a0 = 0;
+   U8 a1 = 0;
+   U8 indices[16] = { };
+   int error = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// When a0 > a1 the palette has 8 values interpolated between the endpoints;
+// otherwise it has 6, plus explicit 0 and 255.
+void fit_alpha_block(const UC (&values)[16], U8 a0, U8 a1, alpha_block_& block) {
+   int palette[8];
+   palette[0] = a0;
+   palette[1] = a1;
+   if (a0 > a1) {
+      for (int i = 2; i < 8; ++i) {
+         palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+      }
+   } else {
+      for (int i = 2; i < 6; ++i) {
+         palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+   }
+
+   block.a0 = a0;
+   block.a1 = a1;
+   block.error = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      U8 best = 0;
+      int best_error = std::abs(int(values[i]) - palette[0]);
+      for (int p = 1; p < 8; ++p) {
+         int error = std::abs(int(values[i]) - palette[p]);
+         if (error < best_error) {
+            best = U8(p);
+            best_error = error;
+         }
+      }
+      block.indices[i] = best;
+      block.error += best_error * best_error;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_alpha_block(const UC (&values)[16], EncodeQuality quality, UC* dest) {
+   int min_value = 255;
+   int max_value = 0;
+   int min_inner = 255;
+   int max_inner = 0;
+   for (UC value : values) {
+      min_value = std::min(min_value, int(value));
+      max_value = std::max(max_value, int(value));
+      if (value != 0 && value != 255) {
+         min_inner = std::min(min_inner, int(value));
+         max_inner = std::max(max_inner, int(value));
+      }
+   }
+
+   alpha_block_ block;
+   fit_alpha_block(values, U8(max_value), U8(min_value), block);
+
+   if (quality != EncodeQuality::fast && block.error > 0) {
+      alpha_block_ candidate;
+      if (min_inner > max_inner) {
+         min_inner = max_inner = 0;
+      }
+      fit_alpha_block(values, U8(min_inner), U8(max_inner), candidate);
+      if (candidate.error < block.error) {
+         block = candidate;
+      }
+   }
+
+   if (quality == EncodeQuality::high && block.error > 0) {
+      for (int d0 = -2; d0 <= 2; ++d0) {
+         for (int d1 = -2; d1 <= 2; ++d1) {
+            int a0 = glm::clamp(max_value + d0, 0, 255);
+            int a1 = glm::clamp(min_value + d1, 0, 255);
+            if (a0 <= a1) {
+               continue;
+            }
+            alpha_block_ candidate;
+            fit_alpha_block(values, U8(a0), U8(a1), candidate);
+            if (candidate.error < block.error) {
+               block = candidate;
+            }
+         }
+      }
+   }
+
+   U64 indices = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      indices |= U64(block.indices[i]) << (3 * i);
+   }
+
+   dest[0] = block.a0;
+   dest[1] = block.a1;
+   write_le(dest + 2, indices, 6);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_field_block(const UC (&texels)[16][4], std::size_t field, EncodeQuality quality, UC* dest) {
+   UC values[16];
+   for (std::size_t i = 0; i < 16; ++i) {
+      values[i] = texels[i][field];
+   }
+   encode_alpha_block(values, quality, dest);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_explicit_alpha(const UC (&texels)[16][4], UC* dest) {
+   U64 alpha = 0;
+   for (std::size_t i = 0; i < 16; ++i) {
+      alpha |= U64((texels[i][3] * 15 + 127) / 255) << (4 * i);
+   }
+   write_le(dest, alpha, 8);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+U64 read_le(const UC* src, std::size_t bytes) {
+   U64 value = 0;
+   for (std::size_t i = 0; i < bytes; ++i) {
+      value |= U64(src[i]) << (8 * i);
+   }
+   return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoded blocks are written as 4 rows of 8-bit RGBA texels into a band of
+// decoded texels, so each 32-bit palette entry can be stored with one write.
+void store_texel(UC* dest, U32 value) {
+   std::memcpy(dest, &value, sizeof(value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+U32 pack_texel(int r, int g, int b, int a) {
+   UC texel[4] = { UC(r), UC(g), UC(b), UC(a) };
+   U32 value;
+   std::memcpy(&value, texel, sizeof(value));
+   return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void decode_color_block(const UC* src, bool three_color_mode, UC* dest, std::size_t dest_line_span) {
+   const U16 c0 = U16(read_le(src, 2));
+   const U16 c1 = U16(read_le(src + 2, 2));
+   U32 indices = U32(read_le(src + 4, 4));
+
+   int colors[4][3];
+   for (int i = 0; i < 2; ++i) {
+      const U16 c = i == 0 ? c0 : c1;
+      const int r = (c >> 11) & 31;
+      const int g = (c >> 5) & 63;
+      const int b = c & 31;
+      colors[i][0] = (r << 3) | (r >> 2);
+      colors[i][1] = (g << 2) | (g >> 4);
+      colors[i][2] = (b << 3) | (b >> 2);
+   }
+
+   U32 palette[4];
+   palette[0] = pack_texel(colors[0][0], colors[0][1], colors[0][2], 255);
+   palette[1] = pack_texel(colors[1][0], colors[1][1], colors[1][2], 255);
+   if (c0 > c1 || !three_color_mode) {
+      for (int i = 0; i < 2; ++i) {
+         const int w0 = 2 - i;
+         const int w1 = 1 + i;
+         palette[2 + i] = pack_texel((w0 * colors[0][0] + w1 * colors[1][0] + 1) / 3,
+                                     (w0 * colors[0][1] + w1 * colors[1][1] + 1) / 3,
+                                     (w0 * colors[0][2] + w1 * colors[1][2] + 1) / 3, 255);
+      }
+   } else {
+      palette[2] = pack_texel((colors[0][0] + colors[1][0] + 1) / 2,
+                              (colors[0][1] + colors[1][1] + 1) / 2,
+                              (colors[0][2] + colors[1][2] + 1) / 2, 255);
+      palette[3] = pack_texel(0, 0, 0, 0);
+   }
+
+   for (int y = 0; y < 4; ++y) {
+      UC* line = dest + y * dest_line_span;
+      for (int x = 0; x < 4; ++x, indices >>= 2) {
+         store_texel(line + x * 4, palette[indices & 3]);
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes a BC3 alpha/RGTC block into one field of each texel.  Signed
+// blocks store two's complement endpoints, with -128 treated as -127.
+void decode_field_block(const UC* src, bool is_signed, std::size_t field, UC* dest, std::size_t dest_line_span) {
+   int a0 = src[0];
+   int a1 = src[1];
+   int min_value = 0;
+   int max_value = 255;
+   if (is_signed) {
+      a0 = std::max(int(static_cast<signed char>(src[0])), -127);
+      a1 = std::max(int(static_cast<signed char>(src[1])), -127);
+      min_value = -127;
+      max_value = 127;
+   }
+
+   int palette[8];
+   palette[0] = a0;
+   palette[1] = a1;
+   if (a0 > a1) {
+      for (int i = 2; i < 8; ++i) {
+         palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+      }
+   } else {
+      for (int i = 2; i < 6; ++i) {
+         palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+      }
+      palette[6] = min_value;
+      palette[7] = max_value;
+   }
+
+   U64 indices = read_le(src + 2, 6);
+   for (int y = 0; y < 4; ++y) {
+      UC* line = dest + y * dest_line_span + field;
+      for (int x = 0; x < 4; ++x, indices >>= 3) {
+         line[x * 4] = UC(palette[indices & 7]);
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void decode_explicit_alpha(const UC* src, UC* dest, std::size_t dest_line_span) {
+   U64 alpha = read_le(src, 8);
+   for (int y = 0; y < 4; ++y) {
+      UC* line = dest + y * dest_line_span + 3;
+      for (int x = 0; x < 4; ++x, alpha >>= 4) {
+         line[x * 4] = UC((alpha & 15) * 17);
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Subset of each texel for the BC7 partitions; 1 bit per texel for 2 subsets,
+// and 2 bits per texel for 3 subsets.
+const U16 bc7_partitions2[64] = {
+   0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+   0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+   0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+   0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+   0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+   0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+   0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+   0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+const U32 bc7_partitions3[64] = {
+   0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+   0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+   0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+   0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+   0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+   0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+   0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+   0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// Texels whose index omits its high bit; subset 0 always uses texel 0.
+const U8 bc7_anchors2[64] = {
+   15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+   15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+   15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+    6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+const U8 bc7_anchors3a[64] = {
+    3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+    3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+    8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+    3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+
+const U8 bc7_anchors3b[64] = {
+   15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+   15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+   15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+   15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+const U8 bc7_weights2[4] = { 0, 21, 43, 64 };
+const U8 bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+const U8 bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+///////////////////////////////////////////////////////////////////////////////
+struct bc7_mode_ {
+   U8 subsets;
+   U8 partition_bits;
+   U8 rotation_bits;
+   U8 index_selection_bits;
+   U8 color_bits;
+   U8 alpha_bits;
+   U8 endpoint_pbits;
+   U8 shared_pbits;
+   U8 index_bits;
+   U8 index2_bits;
+};
+
+const bc7_mode_ bc7_modes[8] = {
+   { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+   { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+   { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+   { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+   { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+   { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+   { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+   { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class bc7_bits_ {
+public:
+   explicit bc7_bits_(const UC* src)
+      : lo_(read_le(src, 8)),
+        hi_(read_le(src + 8, 8)) { }
+
+   U32 read(U32 bits) {
+      if (bits == 0) {
+         return 0;
+      }
+      U64 value;
+      if (pos_ >= 64) {
+         value = hi_ >> (pos_ - 64);
+      } else if (pos_ == 0) {
+         value = lo_;
+      } else {
+         value = (lo_ >> pos_) | (hi_ << (64 - pos_));
+      }
+      pos_ += bits;
+      return U32(value & ((U64(1) << bits) - 1));
+   }
+
+   void skip(U32 bits) {
+      pos_ += bits;
+   }
+
+private:
+   U64 lo_;
+   U64 hi_;
+   U32 pos_ = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+int bc7_expand(U32 value, U32 bits) {
+   return int((value << (8 - bits)) | (value >> (2 * bits - 8)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const U8* bc7_weights(U32 bits) {
+   return bits == 2 ? bc7_weights2 : bits == 3 ? bc7_weights3 : bc7_weights4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void decode_bc7_block(const UC* src, UC* dest, std::size_t dest_line_span) {
+   U32 mode_index = 0;
+   while (mode_index < 8 && (src[0] & (1u << mode_index)) == 0) {
+      ++mode_index;
+   }
+
+   if (mode_index >= 8) {
+      // Reserved mode; decodes to transparent black.
+      for (int y = 0; y < 4; ++y) {
+         std::memset(dest + y * dest_line_span, 0, 16);
+      }
+      return;
+   }
+
+   const bc7_mode_& mode = bc7_modes[mode_index];
+   bc7_bits_ bits(src);
+   bits.skip(mode_index + 1);
+
+   const U32 partition = bits.read(mode.partition_bits);
+   const U32 rotation = bits.read(mode.rotation_bits);
+   const U32 index_selection = bits.read(mode.index_selection_bits);
+
+   const U32 subsets = mode.subsets;
+   const U32 endpoints = subsets * 2;
+   U32 raw[6][4] = { };
+   for (U32 c = 0; c < 3; ++c) {
+      for (U32 e = 0; e < endpoints; ++e) {
+         raw[e][c] = bits.read(mode.color_bits);
+      }
+   }
+   for (U32 e = 0; e < endpoints && mode.alpha_bits > 0; ++e) {
+      raw[e][3] = bits.read(mode.alpha_bits);
+   }
+
+   U32 pbits[6] = { };
+   if (mode.endpoint_pbits) {
+      for (U32 e = 0; e < endpoints; ++e) {
+         pbits[e] = bits.read(1);
+      }
+   } else if (mode.shared_pbits) {
+      for (U32 s = 0; s < subsets; ++s) {
+         pbits[s * 2] = pbits[s * 2 + 1] = bits.read(1);
+      }
+   }
+
+   const U32 pbit_count = (mode.endpoint_pbits || mode.shared_pbits) ? 1 : 0;
+   int colors[6][4];
+   for (U32 e = 0; e < endpoints; ++e) {
+      for (U32 c = 0; c < 3; ++c) {
+         colors[e][c] = bc7_expand((raw[e][c] << pbit_count) | pbits[e], mode.color_bits + pbit_count);
+      }
+      colors[e][3] = mode.alpha_bits > 0 ? bc7_expand((raw[e][3] << pbit_count) | pbits[e], mode.alpha_bits + pbit_count) : 255;
+   }
+
+   U32 texel_subsets[16];
+   U32 anchors[3] = { 0, 0, 0 };
+   for (U32 i = 0; i < 16; ++i) {
+      if (subsets == 2) {
+         texel_subsets[i] = (bc7_partitions2[partition] >> i) & 1;
+      } else if (subsets == 3) {
+         texel_subsets[i] = (bc7_partitions3[partition] >> (2 * i)) & 3;
+      } else {
+         texel_subsets[i] = 0;
+      }
+   }
+   if (subsets == 2) {
+      anchors[1] = bc7_anchors2[partition];
+   } else if (subsets == 3) {
+      anchors[1] = bc7_anchors3a[partition];
+      anchors[2] = bc7_anchors3b[partition];
+   }
+
+   U32 indices[16];
+   for (U32 i = 0; i < 16; ++i) {
+      const bool anchor = i == anchors[texel_subsets[i]];
+      indices[i] = bits.read(mode.index_bits - (anchor ? 1 : 0));
+   }
+
+   U32 indices2[16] = { };
+   for (U32 i = 0; i < 16 && mode.index2_bits > 0; ++i) {
+      indices2[i] = bits.read(mode.index2_bits - (i == 0 ? 1 : 0));
+   }
+
+   const U32* color_indices = indices;
+   const U32* alpha_indices = indices;
+   U32 color_index_bits = mode.index_bits;
+   U32 alpha_index_bits = mode.index_bits;
+   if (mode.index2_bits > 0) {
+      if (index_selection) {
+         color_indices = indices2;
+         color_index_bits = mode.index2_bits;
+      } else {
+         alpha_indices = indices2;
+         alpha_index_bits = mode.index2_bits;
+      }
+   }
+   const U8* color_weights = bc7_weights(color_index_bits);
+   const U8* alpha_weights = bc7_weights(alpha_index_bits);
+
+   for (U32 i = 0; i < 16; ++i) {
+      const int* e0 = colors[texel_subsets[i] * 2];
+      const int* e1 = colors[texel_subsets[i] * 2 + 1];
+      const int cw = color_weights[color_indices[i]];
+      const int aw = alpha_weights[alpha_indices[i]];
+
+      int texel[4];
+      for (int c = 0; c < 3; ++c) {
+         texel[c] = ((64 - cw) * e0[c] + cw * e1[c] + 32) >> 6;
+      }
+      texel[3] = ((64 - aw) * e0[3] + aw * e1[3] + 32) >> 6;
+
+      if (rotation > 0) {
+         std::swap(texel[3], texel[rotation - 1]);
+      }
+
+      store_texel(dest + (i / 4) * dest_line_span + (i % 4) * 4, pack_texel(texel[0], texel[1], texel[2], texel[3]));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes a row of blocks into 4 rows of RGBA texels.  Each codec gets its own
+// loop over the row so the per-block work stays free of codec dispatch.
+void decode_block_row(BlockCodec codec, bool is_signed, const UC* src, std::size_t count, std::size_t block_span, UC* dest, std::size_t dest_line_span) {
+   switch (codec) {
+      case BlockCodec::bc1:
+         for (std::size_t b = 0; b < count; ++b) {
+            decode_color_block(src + b * block_span, true, dest + b * 16, dest_line_span);
+         }
+         break;
+      case BlockCodec::bc2:
+         for (std::size_t b = 0; b < count; ++b) {
+            decode_color_block(src + b * block_span + 8, false, dest + b * 16, dest_line_span);
+            decode_explicit_alpha(src + b * block_span, dest + b * 16, dest_line_span);
+         }
+         break;
+      case BlockCodec::bc3:
+         for (std::size_t b = 0; b < count; ++b) {
+            decode_color_block(src + b * block_span + 8, false, dest + b * 16, dest_line_span);
+            decode_field_block(src + b * block_span, false, 3, dest + b * 16, dest_line_span);
+         }
+         break;
+      case BlockCodec::bc4:
+      case BlockCodec::bc5: {
+         const U32 fill = pack_texel(0, 0, 0, is_signed ? 0 : 255);
+         for (std::size_t y = 0; y < 4; ++y) {
+            UC* line = dest + y * dest_line_span;
+            for (std::size_t x = 0; x < count * 4; ++x) {
+               store_texel(line + x * 4, fill);
+            }
+         }
+         for (std::size_t b = 0; b < count; ++b) {
+            decode_field_block(src + b * block_span, is_signed, 0, dest + b * 16, dest_line_span);
+         }
+         if (codec == BlockCodec::bc5) {
+            for (std::size_t b = 0; b < count; ++b) {
+               decode_field_block(src + b * block_span + 8, is_signed, 1, dest + b * 16, dest_line_span);
+            }
+         }
+         break;
+      }
+      case BlockCodec::bc7:
+         for (std::size_t b = 0; b < count; ++b) {
+            decode_bc7_block(src + b * block_span, dest + b * 16, dest_line_span);
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat rgba8_format(const ImageFormat& format) {
+   ImageFormat result = format;
+   result.packing(BlockPacking::s_8_8_8_8);
+   result.block_dim(ImageFormat::block_dim_type(1));
+   result.block_size(4);
+   ImageFormat::field_types_type field_types = result.field_types();
+   for (int f = 0; f < 4; ++f) {
+      field_types[f] = FieldType::unorm;
+   }
+   result.field_types(field_types);
+   return result;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+BlockCodec block_codec(BlockPacking packing, FieldType field_type) {
+   switch (packing) {
+      case BlockPacking::c_s3tc1: return BlockCodec::bc1;
+      case BlockPacking::c_s3tc2: return BlockCodec::bc2;
+      case BlockPacking::c_s3tc3: return BlockCodec::bc3;
+      case BlockPacking::c_rgtc1: return BlockCodec::bc4;
+      case BlockPacking::c_rgtc2: return BlockCodec::bc5;
+      case BlockPacking::c_bptc:
+         return field_type == FieldType::ufloat || field_type == FieldType::sfloat ? BlockCodec::bc6h : BlockCodec::bc7;
+      default:
+         return BlockCodec::none;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BlockCodec block_codec(const ImageFormat& format) {
+   return block_codec(format.packing(), format.field_type(0));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat::block_size_type codec_block_size(BlockCodec codec) {
+   switch (codec) {
+      case BlockCodec::bc1:
+      case BlockCodec::bc4:
+         return 8;
+      case BlockCodec::none:
+         return 0;
+      default:
+         return 16;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool can_encode(BlockCodec codec) {
+   switch (codec) {
+      case BlockCodec::bc1:
+      case BlockCodec::bc2:
+      case BlockCodec::bc3:
+      case BlockCodec::bc4:
+      case BlockCodec::bc5:
+         return true;
+      default:
+         return false;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool can_decode(BlockCodec codec) {
+   switch (codec) {
+      case BlockCodec::bc1:
+      case BlockCodec::bc2:
+      case BlockCodec::bc3:
+      case BlockCodec::bc4:
+      case BlockCodec::bc5:
+      case BlockCodec::bc7:
+         return true;
+      default:
+         return false;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void encode_block(BlockCodec codec, EncodeQuality quality, const UC (&texels)[16][4], bool use_alpha, UC* dest) {
+   switch (codec) {
+      case BlockCodec::bc1:
+         encode_color_block(texels, use_alpha, false, quality, dest);
+         break;
+      case BlockCodec::bc2:
+         encode_explicit_alpha(texels, dest);
+         encode_color_block(texels, false, true, quality, dest + 8);
+         break;
+      case BlockCodec::bc3:
+         encode_field_block(texels, 3, quality, dest);
+         encode_color_block(texels, false, true, quality, dest + 8);
+         break;
+      case BlockCodec::bc4:
+         encode_field_block(texels, 0, quality, dest);
+         break;
+      case BlockCodec::bc5:
+         encode_field_block(texels, 0, quality, dest);
+         encode_field_block(texels, 1, quality, dest + 8);
+         break;
+      default:
+         break;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool encode_image(const ConstImageView& src, const ImageView& dest, EncodeQuality quality) {
+   const ImageFormat dest_format = dest.format();
+   const BlockCodec codec = block_codec(dest_format);
+   if (!can_encode(codec) || ((codec == BlockCodec::bc4 || codec == BlockCodec::bc5) && dest_format.field_type(0) == FieldType::snorm)) {
+      return false;
+   }
+
+   // Blocks store fields, not channels, so find the channel of the intermediate RGBA image that each field maps to.
+   int field_channel[4] = { -1, -1, -1, -1 };
+   for (int c = 3; c >= 0; --c) {
+      switch (dest_format.swizzle(c)) {
+         case Swizzle::field_zero:  field_channel[0] = c; break;
+         case Swizzle::field_one:   field_channel[1] = c; break;
+         case Swizzle::field_two:   field_channel[2] = c; break;
+         case Swizzle::field_three: field_channel[3] = c; break;
+         default: break;
+      }
+   }
+
+   ImageFormat band_format = rgba8_format(dest_format);
+   band_format.components(4);
+   band_format.swizzles(swizzles_rgba());
+
+   const ivec3 dim = dest.dim();
+   const ivec3 src_dim = glm::min(src.dim(), dim);
+   if (src_dim.x <= 0 || src_dim.y <= 0 || src_dim.z <= 0) {
+      return true;
+   }
+
+   const I32 blocks_x = (dim.x + 3) / 4;
+   const I32 blocks_y = (dim.y + 3) / 4;
+   const bool use_alpha = dest_format.components() >= 4 && field_channel[3] >= 0;
+
+   TextureStorage band_storage(1, 1, 1, ivec3(blocks_x * 4, 4, 1), ImageFormat::block_dim_type(1), 4, TextureAlignment());
+   ImageView band = TextureView(band_format, TextureClass::planar, band_storage, 0, 1, 0, 1, 0, 1).image();
+
+   for (I32 z = 0; z < dim.z; ++z) {
+      const I32 src_z = std::min(z, src_dim.z - 1);
+      for (I32 by = 0; by < blocks_y; ++by) {
+         const I32 y = std::min(by * 4, src_dim.y - 1);
+         const I32 rows = std::min(4, src_dim.y - y);
+         blit_texels(src, ivec3(0, y, src_z), band, ivec3(0), ivec3(src_dim.x, rows, 1));
+
+         const UC* band_data = band.data();
+         const std::size_t band_line_span = band.line_span();
+         UC* dest_line = dest.data() + z * dest.plane_span() + by * dest.line_span();
+
+         for (I32 bx = 0; bx < blocks_x; ++bx) {
+            // Texels past the edge of the image replicate the last row/column, so they don't skew the endpoints.
+            UC texels[16][4];
+            for (I32 py = 0; py < 4; ++py) {
+               const UC* line = band_data + std::min(py, rows - 1) * band_line_span;
+               for (I32 px = 0; px < 4; ++px) {
+                  const UC* texel = line + std::min(bx * 4 + px, src_dim.x - 1) * 4;
+                  for (int f = 0; f < 4; ++f) {
+                     texels[py * 4 + px][f] = field_channel[f] >= 0 ? texel[field_channel[f]] : UC(f == 3 ? 255 : 0);
+                  }
+               }
+            }
+
+            encode_block(codec, quality, texels, use_alpha, dest_line + bx * dest.block_span());
+         }
+      }
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool decode_image(const ConstImageView& src, const ImageView& dest) {
+   const ImageFormat src_format = src.format();
+   const BlockCodec codec = block_codec(src_format);
+   if (!can_decode(codec)) {
+      return false;
+   }
+
+   // The band keeps the source's swizzles and colorspace, so blit_pixels interprets the decoded fields exactly as it
+   // would the blocks themselves.
+   const bool is_signed = (codec == BlockCodec::bc4 || codec == BlockCodec::bc5) && src_format.field_type(0) == FieldType::snorm;
+   ImageFormat band_format = rgba8_format(src_format);
+   if (is_signed) {
+      ImageFormat::field_types_type field_types = band_format.field_types();
+      field_types[0] = field_types[1] = FieldType::snorm;
+      band_format.field_types(field_types);
+   }
+
+   const ivec3 dim = glm::min(src.dim(), dest.dim());
+   if (dim.x <= 0 || dim.y <= 0 || dim.z <= 0) {
+      return true;
+   }
+
+   const I32 blocks_x = (dim.x + 3) / 4;
+   const I32 blocks_y = (dim.y + 3) / 4;
+
+   TextureStorage band_storage(1, 1, 1, ivec3(blocks_x * 4, 4, 1), ImageFormat::block_dim_type(1), 4, TextureAlignment());
+   ImageView band = TextureView(band_format, TextureClass::planar, band_storage, 0, 1, 0, 1, 0, 1).image();
+
+   for (I32 z = 0; z < dim.z; ++z) {
+      for (I32 by = 0; by < blocks_y; ++by) {
+         const I32 y = by * 4;
+         const I32 rows = std::min(4, dim.y - y);
+         const UC* src_line = src.data() + z * src.plane_span() + by * src.line_span();
+         decode_block_row(codec, is_signed, src_line, std::size_t(blocks_x), src.block_span(), band.data(), band.line_span());
+         blit_texels(band, ivec3(0), dest, ivec3(0, y, z), ivec3(dim.x, rows, 1));
+      }
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool transcode_image(const ConstImageView& src, const ImageView& dest, EncodeQuality quality) {
+   if (!can_decode(block_codec(src.format()))) {
+      return false;
+   }
+
+   const ivec3 dim = glm::min(src.dim(), dest.dim());
+   if (dim.x <= 0 || dim.y <= 0 || dim.z <= 0) {
+      return true;
+   }
+
+   ImageFormat temp_format = rgba8_format(src.format());
+   temp_format.components(4);
+   temp_format.swizzles(swizzles_rgba());
+
+   TextureStorage temp_storage(1, 1, 1, dim, ImageFormat::block_dim_type(1), 4, TextureAlignment());
+   ImageView temp = TextureView(temp_format, TextureClass::planar, temp_storage, 0, 1, 0, 1, 0, 1).image();
+   return decode_image(src, temp) && encode_image(temp, dest, quality);
+}
+
+} // be::tools
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_BLOCK_CODEC_HPP_
+#define BE_TOOLS_GFX_BLOCK_CODEC_HPP_
+
+#include <be/gfx/tex/texture.hpp>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+enum class BlockCodec : U8 {
+   none = 0,
+   bc1,  // S3TC DXT1
+   bc2,  // S3TC DXT3
+   bc3,  // S3TC DXT5
+   bc4,  // RGTC1
+   bc5,  // RGTC2
+   bc6h, // BPTC float
+   bc7   // BPTC unorm
+};
+
+///////////////////////////////////////////////////////////////////////////////
+enum class EncodeQuality : U8 {
+   fast = 0,
+   normal,
+   high
+};
+
+BlockCodec block_codec(gfx::tex::BlockPacking packing, gfx::tex::FieldType field_type = gfx::tex::FieldType::unorm);
+BlockCodec block_codec(const gfx::tex::ImageFormat& format);
+gfx::tex::ImageFormat::block_size_type codec_block_size(BlockCodec codec);
+bool can_encode(BlockCodec codec);
+bool can_decode(BlockCodec codec);
+
+void encode_block(BlockCodec codec, EncodeQuality quality, const UC (&texels)[16][4], bool use_alpha, UC* dest);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts an uncompressed image into a block compressed one.
+///
+/// \details The source is converted to 8-bit RGBA one row of blocks at a time,
+///         so no full size temporary image is needed.  Returns false if the
+///         destination format can't be encoded.
+bool encode_image(const gfx::tex::ConstImageView& src, const gfx::tex::ImageView& dest, EncodeQuality quality);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a block compressed image into an uncompressed one.
+///
+/// \details Blocks are decoded one row at a time into an 8-bit band which
+///         is then blitted to the destination.  Returns false if the source
+///         format can't be decoded.
+bool decode_image(const gfx::tex::ConstImageView& src, const gfx::tex::ImageView& dest);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts between two block compressed formats by way of a
+///         temporary 8-bit RGBA image.
+bool transcode_image(const gfx::tex::ConstImageView& src, const gfx::tex::ImageView& dest, EncodeQuality quality);
+
+} // be::tools
+
+#endif
@@ -0,0 +1,443 @@
+#include "dds_writer.hpp"
+#include "block_codec.hpp"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace be::tools {
+namespace {
+
+using namespace gfx::tex;
+
+constexpr U32 ddsd_caps = 0x1;
+constexpr U32 ddsd_height = 0x2;
+constexpr U32 ddsd_width = 0x4;
+constexpr U32 ddsd_pitch = 0x8;
+constexpr U32 ddsd_pixelformat = 0x1000;
+constexpr U32 ddsd_mipmapcount = 0x20000;
+constexpr U32 ddsd_linearsize = 0x80000;
+constexpr U32 ddsd_depth = 0x800000;
+
+constexpr U32 ddpf_alphapixels = 0x1;
+constexpr U32 ddpf_fourcc = 0x4;
+constexpr U32 ddpf_rgb = 0x40;
+
+constexpr U32 ddscaps_complex = 0x8;
+constexpr U32 ddscaps_texture = 0x1000;
+constexpr U32 ddscaps_mipmap = 0x400000;
+
+constexpr U32 ddscaps2_cubemap = 0x200;
+constexpr U32 ddscaps2_cubemap_all_faces = 0xFC00;
+constexpr U32 ddscaps2_volume = 0x200000;
+
+constexpr U32 d3d10_resource_dimension_texture1d = 2;
+constexpr U32 d3d10_resource_dimension_texture2d = 3;
+constexpr U32 d3d10_resource_dimension_texture3d = 4;
+constexpr U32 d3d10_resource_misc_texturecube = 0x4;
+
+constexpr U32 dds_alpha_mode_straight = 1;
+constexpr U32 dds_alpha_mode_premultiplied = 2;
+constexpr U32 dds_alpha_mode_opaque = 3;
+
+constexpr std::size_t header_size = 128;
+constexpr std::size_t dx10_header_size = 20;
+
+///////////////////////////////////////////////////////////////////////////////
+constexpr U32 fourcc(const char (&code)[5]) {
+   return U32(UC(code[0])) | (U32(UC(code[1])) << 8) | (U32(UC(code[2])) << 16) | (U32(UC(code[3])) << 24);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void write_le(UC* dest, U32 value) {
+   for (std::size_t i = 0; i < 4; ++i) {
+      dest[i] = UC(value >> (8 * i));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Swizzle field_swizzle(std::size_t field) {
+   return Swizzle(U8(Swizzle::field_zero) + field);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool has_swizzles(const ImageFormat& format, const Swizzle (&swizzles)[4]) {
+   for (std::size_t c = 0; c < format.components() && c < 4; ++c) {
+      if (format.swizzle(int(c)) != swizzles[c]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool has_uniform_field_type(const ImageFormat& format) {
+   for (std::size_t f = 1; f < field_count(format.packing()) && f < 4; ++f) {
+      if (format.field_type(int(f)) != format.field_type(0)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct dxgi_formats_ {
+   BlockPacking packing;
+   U32 unorm;
+   U32 snorm;
+   U32 uint;
+   U32 sint;
+   U32 sfloat;
+};
+
+const dxgi_formats_ dxgi_table[] = {
+   { BlockPacking::s_8,           61, 63, 62, 64,  0 },
+   { BlockPacking::s_8_8,         49, 51, 50, 52,  0 },
+   { BlockPacking::s_8_8_8_8,     28, 31, 30, 32,  0 },
+   { BlockPacking::s_16,          56, 58, 57, 59, 54 },
+   { BlockPacking::s_16_16,       35, 37, 36, 38, 34 },
+   { BlockPacking::s_16_16_16_16, 11, 13, 12, 14, 10 },
+   { BlockPacking::s_32,           0,  0, 42, 43, 41 },
+   { BlockPacking::s_32_32,        0,  0, 17, 18, 16 },
+   { BlockPacking::s_32_32_32,     0,  0,  7,  8,  6 },
+   { BlockPacking::s_32_32_32_32,  0,  0,  3,  4,  2 },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the DXGI_FORMAT which stores texels exactly as the given format
+// does, or 0 (DXGI_FORMAT_UNKNOWN) if there isn't one.
+U32 dxgi_format(const ImageFormat& format) {
+   const bool srgb = format.colorspace() == Colorspace::srgb;
+   const FieldType type = format.field_type(0);
+   const bool snorm = type == FieldType::snorm;
+
+   if (is_compressed(format.packing())) {
+      const BlockCodec codec = block_codec(format);
+      if (codec == BlockCodec::none || format.block_size() != codec_block_size(codec) ||
+          format.block_dim() != ImageFormat::block_dim_type(4, 4, 1)) {
+         return 0;
+      }
+
+      switch (codec) {
+         case BlockCodec::bc1:  return srgb ? 72 : 71;
+         case BlockCodec::bc2:  return srgb ? 75 : 74;
+         case BlockCodec::bc3:  return srgb ? 78 : 77;
+         case BlockCodec::bc4:  return snorm ? 81 : 80;
+         case BlockCodec::bc5:  return snorm ? 84 : 83;
+         case BlockCodec::bc6h: return type == FieldType::sfloat ? 96 : 95;
+         case BlockCodec::bc7:  return srgb ? 99 : 98;
+         default:               return 0;
+      }
+   }
+
+   if (!has_uniform_field_type(format) || format.block_dim() != ImageFormat::block_dim_type(1) ||
+       format.block_size() != block_word_size(format.packing()) * block_word_count(format.packing())) {
+      return 0;
+   }
+
+   static const Swizzle rgba[4] = { Swizzle::field_zero, Swizzle::field_one, Swizzle::field_two, Swizzle::field_three };
+   static const Swizzle bgra[4] = { Swizzle::field_two, Swizzle::field_one, Swizzle::field_zero, Swizzle::field_three };
+   if (!has_swizzles(format, rgba)) {
+      if (format.packing() == BlockPacking::s_8_8_8_8 && type == FieldType::unorm && has_swizzles(format, bgra)) {
+         if (format.components() < 4) {
+            return srgb ? 93 : 88;
+         }
+         return srgb ? 91 : 87;
+      }
+      return 0;
+   }
+
+   for (const dxgi_formats_& entry : dxgi_table) {
+      if (entry.packing != format.packing()) {
+         continue;
+      }
+
+      switch (type) {
+         case FieldType::unorm:
+            return srgb && entry.packing == BlockPacking::s_8_8_8_8 ? 29 : entry.unorm;
+         case FieldType::snorm:  return entry.snorm;
+         case FieldType::uint:   return entry.uint;
+         case FieldType::sint:   return entry.sint;
+         case FieldType::sfloat: return entry.sfloat;
+         default:                return 0;
+      }
+   }
+
+   return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct legacy_pixel_format_ {
+   U32 flags = 0;
+   U32 fourcc = 0;
+   U32 bit_count = 0;
+   U32 masks[4] = { };
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Legacy pixel formats can't express sRGB, so those always need a DX10 header.
+bool legacy_pixel_format(const ImageFormat& format, legacy_pixel_format_& pf) {
+   if (format.colorspace() == Colorspace::srgb) {
+      return false;
+   }
+
+   const bool snorm = format.field_type(0) == FieldType::snorm;
+   if (is_compressed(format.packing())) {
+      if (dxgi_format(format) == 0) {
+         return false;
+      }
+
+      pf.flags = ddpf_fourcc;
+      switch (block_codec(format)) {
+         case BlockCodec::bc1: pf.fourcc = fourcc("DXT1"); break;
+         case BlockCodec::bc2: pf.fourcc = fourcc(format.premultiplied() ? "DXT2" : "DXT3"); break;
+         case BlockCodec::bc3: pf.fourcc = fourcc(format.premultiplied() ? "DXT4" : "DXT5"); break;
+         case BlockCodec::bc4: pf.fourcc = fourcc(snorm ? "BC4S" : "BC4U"); break;
+         case BlockCodec::bc5: pf.fourcc = fourcc(snorm ? "BC5S" : "ATI2"); break;
+         default: return false;
+      }
+      return true;
+   }
+
+   if ((format.packing() != BlockPacking::s_8_8_8 && format.packing() != BlockPacking::s_8_8_8_8) ||
+       !has_uniform_field_type(format) || format.field_type(0) != FieldType::unorm ||
+       format.block_dim() != ImageFormat::block_dim_type(1) ||
+       format.block_size() != block_word_size(format.packing()) * block_word_count(format.packing())) {
+      return false;
+   }
+
+   // Channel masks can describe any ordering of 8-bit fields, but every color channel needs one.
+   pf.flags = ddpf_rgb;
+   pf.bit_count = U32(8 * field_count(format.packing()));
+   for (std::size_t c = 0; c < 4; ++c) {
+      std::size_t field = 4;
+      for (std::size_t f = 0; f < field_count(format.packing()); ++f) {
+         if (c < format.components() && format.swizzle(int(c)) == field_swizzle(f)) {
+            field = f;
+         }
+      }
+
+      if (field < 4) {
+         pf.masks[c] = U32(0xFF) << (8 * field);
+      } else if (c < 3) {
+         return false;
+      }
+   }
+
+   if (pf.masks[3] != 0) {
+      pf.flags |= ddpf_alphapixels;
+   }
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct image_layout_ {
+   std::size_t line_size;
+   std::size_t lines;
+   std::size_t planes;
+   std::size_t size;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+image_layout_ tight_layout(const ConstImageView& image) {
+   const ImageFormat::block_dim_type block_dim = image.format().block_dim();
+   const ivec3 dim = image.dim();
+   image_layout_ layout;
+   layout.line_size = std::size_t((dim.x + block_dim.x - 1) / block_dim.x) * image.format().block_size();
+   layout.lines = std::size_t((dim.y + block_dim.y - 1) / block_dim.y);
+   layout.planes = std::size_t((dim.z + block_dim.z - 1) / block_dim.z);
+   layout.size = layout.line_size * layout.lines * layout.planes;
+   return layout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ConstImageView view_image(const ConstTextureView& view, std::size_t layer, std::size_t face, std::size_t level) {
+   return ConstTextureView(view.format(), view.texture_class(), view.storage(),
+                           view.base_layer() + layer, 1,
+                           view.base_face() + face, 1,
+                           view.base_level() + level, 1).image();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DDS stores each layer's faces in order, each face's levels in order, and
+// each level's planes, lines, and blocks with no padding.  When the storage
+// matches that exactly, returns the start of the whole payload.
+const UC* contiguous_payload(const ConstTextureView& view, std::size_t& size) {
+   const UC* begin = nullptr;
+   const UC* expected = nullptr;
+   for (std::size_t layer = 0; layer < view.layers(); ++layer) {
+      for (std::size_t face = 0; face < view.faces(); ++face) {
+         for (std::size_t level = 0; level < view.levels(); ++level) {
+            const ConstImageView image = view_image(view, layer, face, level);
+            const image_layout_ layout = tight_layout(image);
+            if (image.block_span() != image.format().block_size() ||
+                (layout.lines > 1 && image.line_span() != layout.line_size) ||
+                (layout.planes > 1 && image.plane_span() != layout.line_size * layout.lines) ||
+                (expected && image.data() != expected)) {
+               return nullptr;
+            }
+
+            if (!begin) {
+               begin = image.data();
+            }
+            expected = image.data() + layout.size;
+         }
+      }
+   }
+
+   size = std::size_t(expected - begin);
+   return begin;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void write_image(std::ostream& os, const ConstImageView& image, std::vector<UC>& line_buffer) {
+   const image_layout_ layout = tight_layout(image);
+   const std::size_t block_size = image.format().block_size();
+   const std::size_t block_span = image.block_span();
+   const std::size_t blocks = layout.line_size / block_size;
+
+   for (std::size_t plane = 0; plane < layout.planes; ++plane) {
+      const UC* line = image.data() + plane * image.plane_span();
+      for (std::size_t y = 0; y < layout.lines; ++y, line += image.line_span()) {
+         if (block_span == block_size) {
+            os.write(reinterpret_cast<const char*>(line), layout.line_size);
+            continue;
+         }
+
+         line_buffer.resize(layout.line_size);
+         for (std::size_t b = 0; b < blocks; ++b) {
+            std::memcpy(line_buffer.data() + b * block_size, line + b * block_span, block_size);
+         }
+         os.write(reinterpret_cast<const char*>(line_buffer.data()), layout.line_size);
+      }
+   }
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+void DdsWriter::texture(const ConstTextureView& view) {
+   view_ = view;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void DdsWriter::force_dx10_header(bool force) {
+   force_dx10_header_ = force;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void DdsWriter::write(const Path& path, std::error_code& ec) {
+   if (!view_ || view_.layers() == 0 || view_.levels() == 0 || (view_.faces() != 1 && view_.faces() != 6)) {
+      ec = std::make_error_code(std::errc::invalid_argument);
+      return;
+   }
+
+   const ImageFormat format = view_.format();
+   const ConstImageView base_image = view_image(view_, 0, 0, 0);
+   const ivec3 dim = base_image.dim();
+   const image_layout_ base_layout = tight_layout(base_image);
+   const bool cube = view_.faces() == 6;
+   const bool volume = dim.z > 1 || dimensionality(view_.texture_class()) == 3;
+   const bool array = is_array(view_.texture_class()) || view_.layers() > 1;
+
+   legacy_pixel_format_ pf;
+   const bool dx10 = force_dx10_header_ || array || !legacy_pixel_format(format, pf);
+   const U32 dxgi = dx10 ? dxgi_format(format) : 0;
+   if ((dx10 && dxgi == 0) || (volume && (cube || view_.layers() > 1))) {
+      ec = std::make_error_code(std::errc::not_supported);
+      return;
+   }
+
+   UC header[header_size + dx10_header_size] = { };
+   std::memcpy(header, "DDS ", 4);
+
+   U32 flags = ddsd_caps | ddsd_height | ddsd_width | ddsd_pixelformat;
+   flags |= is_compressed(format.packing()) ? ddsd_linearsize : ddsd_pitch;
+   U32 caps = ddscaps_texture;
+   U32 caps2 = 0;
+   if (view_.levels() > 1) {
+      flags |= ddsd_mipmapcount;
+      caps |= ddscaps_complex | ddscaps_mipmap;
+   }
+   if (cube) {
+      caps |= ddscaps_complex;
+      caps2 |= ddscaps2_cubemap | ddscaps2_cubemap_all_faces;
+   }
+   if (volume) {
+      flags |= ddsd_depth;
+      caps |= ddscaps_complex;
+      caps2 |= ddscaps2_volume;
+   }
+
+   write_le(header + 4, 124);
+   write_le(header + 8, flags);
+   write_le(header + 12, U32(dim.y));
+   write_le(header + 16, U32(dim.x));
+   write_le(header + 20, U32(is_compressed(format.packing()) ? base_layout.size : base_layout.line_size));
+   write_le(header + 24, U32(volume ? dim.z : 0));
+   write_le(header + 28, U32(view_.levels()));
+   write_le(header + 76, 32);
+   write_le(header + 108, caps);
+   write_le(header + 112, caps2);
+
+   std::size_t size = header_size;
+   if (dx10) {
+      U32 dimension = d3d10_resource_dimension_texture2d;
+      if (volume) {
+         dimension = d3d10_resource_dimension_texture3d;
+      } else if (dimensionality(view_.texture_class()) == 1 && !cube) {
+         dimension = d3d10_resource_dimension_texture1d;
+      }
+
+      U32 alpha_mode = dds_alpha_mode_opaque;
+      if (format.premultiplied()) {
+         alpha_mode = dds_alpha_mode_premultiplied;
+      } else if (format.components() >= 4) {
+         alpha_mode = dds_alpha_mode_straight;
+      }
+
+      write_le(header + 80, ddpf_fourcc);
+      write_le(header + 84, fourcc("DX10"));
+      write_le(header + 128, dxgi);
+      write_le(header + 132, dimension);
+      write_le(header + 136, cube ? d3d10_resource_misc_texturecube : 0);
+      write_le(header + 140, U32(view_.layers()));
+      write_le(header + 144, alpha_mode);
+      size += dx10_header_size;
+   } else {
+      write_le(header + 80, pf.flags);
+      write_le(header + 84, pf.fourcc);
+      write_le(header + 88, pf.bit_count);
+      for (std::size_t c = 0; c < 4; ++c) {
+         write_le(header + 92 + 4 * c, pf.masks[c]);
+      }
+   }
+
+   std::ofstream os(path.string(), std::ios::binary | std::ios::trunc);
+   if (!os) {
+      ec = std::make_error_code(std::errc::io_error);
+      return;
+   }
+
+   os.write(reinterpret_cast<const char*>(header), size);
+
+   std::size_t payload_size = 0;
+   if (const UC* payload = contiguous_payload(view_, payload_size)) {
+      os.write(reinterpret_cast<const char*>(payload), payload_size);
+   } else {
+      std::vector<UC> line_buffer;
+      for (std::size_t layer = 0; layer < view_.layers(); ++layer) {
+         for (std::size_t face = 0; face < view_.faces(); ++face) {
+            for (std::size_t level = 0; level < view_.levels(); ++level) {
+               write_image(os, view_image(view_, layer, face, level), line_buffer);
+            }
+         }
+      }
+   }
+
+   os.flush();
+   if (!os) {
+      ec = std::make_error_code(std::errc::io_error);
+   }
+}
+
+} // be::tools
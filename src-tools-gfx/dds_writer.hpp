@@ -0,0 +1,33 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_DDS_WRITER_HPP_
+#define BE_TOOLS_GFX_DDS_WRITER_HPP_
+
+#include <be/core/filesystem.hpp>
+#include <be/gfx/tex/texture.hpp>
+#include <system_error>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes textures to DirectDraw Surface files.
+///
+/// \details A legacy header is used whenever the texture can be described by
+///         one; arrays, sRGB textures, and formats that only have a DXGI
+///         equivalent get the additional DX10 header.  If the storage is
+///         already laid out the way DDS requires, it's written directly with
+///         a single write; otherwise images are repacked one line at a time.
+class DdsWriter final {
+public:
+   void texture(const gfx::tex::ConstTextureView& view);
+   void force_dx10_header(bool force);
+
+   void write(const Path& path, std::error_code& ec);
+
+private:
+   gfx::tex::ConstTextureView view_;
+   bool force_dx10_header_ = false;
+};
+
+} // be::tools
+
+#endif
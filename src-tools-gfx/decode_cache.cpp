@@ -0,0 +1,127 @@
+#include "decode_cache.hpp"
+
+namespace be::tools {
+
+using namespace be::gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+DecodeCache::DecodeCache(std::size_t budget)
+   : budget_(budget) { }
+
+///////////////////////////////////////////////////////////////////////////////
+DecodedTexture DecodeCache::read(const Path& path, TextureFileFormat format, Profiler* profiler) {
+   DecodedTexture result;
+   if (find(path, format, result)) {
+      return result;
+   }
+
+   // The file is checked before it's read, so if it changes while being decoded the entry is simply stale on the
+   // next lookup.
+   const FileStamp stamp = file_stamp(path);
+   return insert(path, format, stamp, read_texture_file(path, format, false, profiler));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool DecodeCache::contains(const Path& path, TextureFileFormat format) const {
+   const FileStamp stamp = file_stamp(path);
+   if (!stamp.valid) {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = index_.find(key_(path, format));
+   return it != index_.end() && it->second->stamp.size == stamp.size && it->second->stamp.mtime == stamp.mtime;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool DecodeCache::find(const Path& path, TextureFileFormat format, DecodedTexture& result) {
+   const FileStamp stamp = file_stamp(path);
+   if (!stamp.valid) {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = index_.find(key_(path, format));
+   if (it != index_.end()) {
+      entry_& entry = *it->second;
+      if (entry.stamp.size == stamp.size && entry.stamp.mtime == stamp.mtime) {
+         entries_.splice(entries_.begin(), entries_, it->second);
+         ++hits_;
+         result = share_(entry, true);
+         return true;
+      }
+      size_ -= entry_size_(entry);
+      entries_.erase(it->second);
+      index_.erase(it);
+   }
+   ++misses_;
+   return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+DecodedTexture DecodeCache::insert(const Path& path, TextureFileFormat format, const FileStamp& stamp, DecodedTexture decoded) {
+   if (!stamp.valid || decoded.read_error || decoded.parse_error || decoded.mapping || !decoded.texture.view || !decoded.texture.storage) {
+      return decoded;
+   }
+
+   if (decoded.texture.storage->size() + (decoded.contents ? decoded.contents->size() : 0) > budget_) {
+      return decoded;
+   }
+
+   entry_ entry { key_(path, format), stamp, decoded.file_format, std::move(decoded.contents), std::move(decoded.texture.storage), decoded.texture.view };
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = index_.find(entry.key);
+   if (it != index_.end()) {
+      // Another worker decoded the same file at the same time; keep whichever finished first.
+      return share_(*it->second, false);
+   }
+
+   size_ += entry_size_(entry);
+   entries_.push_front(std::move(entry));
+   index_.emplace(entries_.front().key, entries_.begin());
+
+   while (size_ > budget_) {
+      entry_& oldest = entries_.back();
+      size_ -= entry_size_(oldest);
+      index_.erase(oldest.key);
+      entries_.pop_back();
+   }
+
+   return share_(entries_.front(), false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t DecodeCache::hits() const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   return hits_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t DecodeCache::misses() const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   return misses_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+S DecodeCache::key_(const Path& path, TextureFileFormat format) {
+   return std::to_string(static_cast<int>(format)) + ':' + path.string();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t DecodeCache::entry_size_(const entry_& entry) {
+   return entry.storage->size() + (entry.contents ? entry.contents->size() : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+DecodedTexture DecodeCache::share_(const entry_& entry, bool hit) {
+   DecodedTexture result;
+   result.file_format = entry.file_format;
+   result.contents = entry.contents;
+   result.shared_storage = entry.storage;
+   result.texture.view = entry.view;
+   result.cache_hit = hit;
+   return result;
+}
+
+} // be::tools
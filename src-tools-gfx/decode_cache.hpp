@@ -0,0 +1,65 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_DECODE_CACHE_HPP_
+#define BE_TOOLS_GFX_DECODE_CACHE_HPP_
+
+#include "texture_io.hpp"
+#include <be/core/filesystem.hpp>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps recently decoded texture files in memory, so that jobs which
+///         read the same file don't decode it again.
+///
+/// \details Entries are validated against the file's size and modification
+///         time on every lookup.  Once the total size of cached textures (and
+///         any file contents their storage refers to) exceeds the budget, the
+///         least recently used entries are dropped; storage still in use by a
+///         job is released when the job is done with it.  Memory mapped
+///         textures are never cached, and textures passed to insert() must not
+///         refer to arena memory, since cached textures outlive both.  May be
+///         used from any thread.
+class DecodeCache final {
+public:
+   explicit DecodeCache(std::size_t budget);
+   DecodeCache(const DecodeCache&) = delete;
+   DecodeCache& operator=(const DecodeCache&) = delete;
+
+   DecodedTexture read(const Path& path, gfx::tex::TextureFileFormat format, Profiler* profiler);
+
+   bool contains(const Path& path, gfx::tex::TextureFileFormat format) const;
+   bool find(const Path& path, gfx::tex::TextureFileFormat format, DecodedTexture& result);
+   DecodedTexture insert(const Path& path, gfx::tex::TextureFileFormat format, const FileStamp& stamp, DecodedTexture decoded);
+
+   std::size_t hits() const;
+   std::size_t misses() const;
+
+private:
+   struct entry_ {
+      S key;
+      FileStamp stamp;
+      gfx::tex::TextureFileFormat file_format;
+      std::shared_ptr<const std::vector<UC>> contents;
+      std::shared_ptr<gfx::tex::TextureStorage> storage;
+      gfx::tex::TextureView view;
+   };
+
+   static S key_(const Path& path, gfx::tex::TextureFileFormat format);
+   static std::size_t entry_size_(const entry_& entry);
+   static DecodedTexture share_(const entry_& entry, bool hit);
+
+   const std::size_t budget_;
+   mutable std::mutex mutex_;
+   std::list<entry_> entries_; // most recently used first
+   std::unordered_map<S, std::list<entry_>::iterator> index_;
+   std::size_t size_ = 0;
+   std::size_t hits_ = 0;
+   std::size_t misses_ = 0;
+};
+
+} // be::tools
+
+#endif
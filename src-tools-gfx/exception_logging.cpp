@@ -0,0 +1,31 @@
+#include "exception_logging.hpp"
+#include <be/core/log_exception.hpp>
+#include <be/core/logging.hpp>
+#include <be/cli/cli.hpp>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+void log_current_exception() {
+   try {
+      throw;
+   } catch (const cli::OptionError& e) {
+      log_exception(e);
+   } catch (const cli::ArgumentError& e) {
+      log_exception(e);
+   } catch (const FatalTrace& e) {
+      log_exception(e);
+   } catch (const RecoverableTrace& e) {
+      log_exception(e);
+   } catch (const fs::filesystem_error& e) {
+      log_exception(e);
+   } catch (const std::system_error& e) {
+      log_exception(e);
+   } catch (const std::exception& e) {
+      log_exception(e);
+   } catch (...) {
+      be_error() << "Unknown exception!" | default_log();
+   }
+}
+
+} // be::tools
@@ -0,0 +1,19 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_EXCEPTION_LOGGING_HPP_
+#define BE_TOOLS_GFX_EXCEPTION_LOGGING_HPP_
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Logs the exception currently being handled using the most specific
+///         log_exception overload available for it.
+///
+/// \details Must only be called from within a catch block.  Handles CLI
+///         option and argument errors, traced exceptions, filesystem and
+///         system errors, and any other std::exception; anything else is
+///         logged as an unknown exception.
+void log_current_exception();
+
+} // be::tools
+
+#endif
@@ -0,0 +1,29 @@
+#include "json_writer.hpp"
+#include <ostream>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+void write_json_string(std::ostream& os, const S& str) {
+   static const char digits[] = "0123456789abcdef";
+   os << '"';
+   for (char c : str) {
+      switch (c) {
+         case '"':  os << "\\\""; break;
+         case '\\': os << "\\\\"; break;
+         case '\n': os << "\\n"; break;
+         case '\r': os << "\\r"; break;
+         case '\t': os << "\\t"; break;
+         default:
+            if (U8(c) < 0x20) {
+               os << "\\u00" << digits[U8(c) >> 4] << digits[U8(c) & 0xF];
+            } else {
+               os << c;
+            }
+            break;
+      }
+   }
+   os << '"';
+}
+
+} // be::tools
@@ -0,0 +1,17 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_JSON_WRITER_HPP_
+#define BE_TOOLS_GFX_JSON_WRITER_HPP_
+
+#include <be/core/be.hpp>
+#include <iosfwd>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes str as a quoted JSON string, escaping quotes, backslashes,
+///         and control characters.
+void write_json_string(std::ostream& os, const S& str);
+
+} // be::tools
+
+#endif
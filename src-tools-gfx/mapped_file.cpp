@@ -0,0 +1,128 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace be::tools {
+
+#ifdef _WIN32
+
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::MappedFile(const Path& path, std::error_code& ec) noexcept {
+   HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (file == INVALID_HANDLE_VALUE) {
+      ec = std::error_code(int(GetLastError()), std::system_category());
+      return;
+   }
+   file_ = file;
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size)) {
+      ec = std::error_code(int(GetLastError()), std::system_category());
+      return;
+   }
+
+   if (size.QuadPart == 0) {
+      ec = std::make_error_code(std::errc::invalid_argument);
+      return;
+   }
+
+   HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (mapping == nullptr) {
+      ec = std::error_code(int(GetLastError()), std::system_category());
+      return;
+   }
+   mapping_ = mapping;
+
+   const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (data == nullptr) {
+      ec = std::error_code(int(GetLastError()), std::system_category());
+      return;
+   }
+
+   data_ = static_cast<const UC*>(data);
+   size_ = std::size_t(size.QuadPart);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::~MappedFile() {
+   if (data_) {
+      UnmapViewOfFile(data_);
+   }
+   if (mapping_) {
+      CloseHandle(mapping_);
+   }
+   if (file_) {
+      CloseHandle(file_);
+   }
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::MappedFile(const Path& path, std::error_code& ec) noexcept {
+   fd_ = ::open(path.c_str(), O_RDONLY);
+   if (fd_ < 0) {
+      ec = std::error_code(errno, std::generic_category());
+      return;
+   }
+
+   struct stat st;
+   if (::fstat(fd_, &st) != 0) {
+      ec = std::error_code(errno, std::generic_category());
+      return;
+   }
+
+   if (st.st_size == 0) {
+      ec = std::make_error_code(std::errc::invalid_argument);
+      return;
+   }
+
+   void* data = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+   if (data == MAP_FAILED) {
+      ec = std::error_code(errno, std::generic_category());
+      return;
+   }
+
+   ::madvise(data, std::size_t(st.st_size), MADV_SEQUENTIAL);
+
+   data_ = static_cast<const UC*>(data);
+   size_ = std::size_t(st.st_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::~MappedFile() {
+   if (data_) {
+      ::munmap(const_cast<UC*>(data_), size_);
+   }
+   if (fd_ >= 0) {
+      ::close(fd_);
+   }
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+const UC* MappedFile::data() const noexcept {
+   return data_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t MappedFile::size() const noexcept {
+   return size_;
+}
+
+} // be::tools
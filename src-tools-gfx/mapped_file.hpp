@@ -0,0 +1,38 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_MAPPED_FILE_HPP_
+#define BE_TOOLS_GFX_MAPPED_FILE_HPP_
+
+#include <be/core/filesystem.hpp>
+#include <system_error>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A read-only memory mapping of an entire file.
+///
+/// \details Pages are faulted in by the OS as they are accessed, so the file
+///         contents never need to be copied into heap memory.
+class MappedFile final {
+public:
+   MappedFile(const Path& path, std::error_code& ec) noexcept;
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+   ~MappedFile();
+
+   const UC* data() const noexcept;
+   std::size_t size() const noexcept;
+
+private:
+   const UC* data_ = nullptr;
+   std::size_t size_ = 0;
+#ifdef _WIN32
+   void* file_ = nullptr;
+   void* mapping_ = nullptr;
+#else
+   int fd_ = -1;
+#endif
+};
+
+} // be::tools
+
+#endif
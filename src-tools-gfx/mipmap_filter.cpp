@@ -0,0 +1,245 @@
+#include "mipmap_filter.hpp"
+#include "blit_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace be::tools {
+namespace {
+
+using namespace gfx::tex;
+
+constexpr float pi = 3.14159265358979f;
+constexpr float windowed_radius = 3.f;
+constexpr float kaiser_alpha = 4.f;
+
+///////////////////////////////////////////////////////////////////////////////
+ImageFormat work_format() {
+   ImageFormat format;
+   format.packing(BlockPacking::s_32_32_32_32);
+   format.block_dim(ImageFormat::block_dim_type(1));
+   format.block_size(16);
+   format.components(4);
+   format.field_types(ImageFormat::field_types_type(FieldType::sfloat));
+   format.swizzles(swizzles_rgba());
+   format.colorspace(Colorspace::linear_other);
+   format.premultiplied(true);
+   return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+float sinc(float x) {
+   if (std::abs(x) < 1e-5f) {
+      return 1.f;
+   }
+   x *= pi;
+   return std::sin(x) / x;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+float bessel_i0(float x) {
+   float sum = 1.f;
+   float term = 1.f;
+   const float half_x2 = x * x * 0.25f;
+   for (int k = 1; k < 32 && term > sum * 1e-8f; ++k) {
+      term *= half_x2 / float(k * k);
+      sum += term;
+   }
+   return sum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// x is measured in destination texels.
+float windowed_weight(MipmapFilter filter, float x) {
+   const float t = x / windowed_radius;
+   if (std::abs(t) >= 1.f) {
+      return 0.f;
+   }
+
+   if (filter == MipmapFilter::kaiser) {
+      return sinc(x) * bessel_i0(kaiser_alpha * std::sqrt(1.f - t * t)) / bessel_i0(kaiser_alpha);
+   }
+   return sinc(x) * sinc(t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+struct tap_ {
+   I32 index;
+   float weight;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// The source texels (clamped to the edge) and normalized weights which
+// contribute to each destination texel along one axis.
+struct axis_taps_ {
+   std::vector<tap_> taps;
+   std::vector<std::size_t> offsets;
+
+   const tap_* begin(I32 i) const { return taps.data() + offsets[i]; }
+   const tap_* end(I32 i) const { return taps.data() + offsets[i + 1]; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+axis_taps_ make_axis_taps(MipmapFilter filter, I32 src_size, I32 dest_size) {
+   axis_taps_ result;
+   result.offsets.reserve(dest_size + 1);
+   result.offsets.push_back(0);
+
+   const float scale = float(src_size) / float(dest_size);
+   for (I32 d = 0; d < dest_size; ++d) {
+      const std::size_t first = result.taps.size();
+      if (src_size == dest_size) {
+         result.taps.push_back(tap_ { d, 1.f });
+      } else {
+         const float center = (d + 0.5f) * scale;
+         const float radius = filter == MipmapFilter::box ? scale * 0.5f : scale * windowed_radius;
+         const I32 s_begin = I32(std::floor(center - radius));
+         const I32 s_end = I32(std::ceil(center + radius));
+
+         float total = 0.f;
+         for (I32 s = s_begin; s < s_end; ++s) {
+            float weight;
+            if (filter == MipmapFilter::box) {
+               weight = std::min(float(s + 1), center + radius) - std::max(float(s), center - radius);
+            } else {
+               weight = windowed_weight(filter, (s + 0.5f - center) / scale);
+            }
+
+            if (weight == 0.f || (filter == MipmapFilter::box && weight < 0.f)) {
+               continue;
+            }
+
+            const I32 index = glm::clamp(s, 0, src_size - 1);
+            if (result.taps.size() > first && result.taps.back().index == index) {
+               result.taps.back().weight += weight;
+            } else {
+               result.taps.push_back(tap_ { index, weight });
+            }
+            total += weight;
+         }
+
+         if (total != 0.f) {
+            for (std::size_t i = first; i < result.taps.size(); ++i) {
+               result.taps[i].weight /= total;
+            }
+         }
+      }
+      result.offsets.push_back(result.taps.size());
+   }
+
+   return result;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+MipmapImage::MipmapImage(ivec3 dim)
+   : storage_(std::make_unique<TextureStorage>(1, 1, 1, dim, ImageFormat::block_dim_type(1), 16, TextureAlignment())) {
+   view_ = TextureView(work_format(), TextureClass::planar, *storage_, 0, 1, 0, 1, 0, 1).image();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ivec3 MipmapImage::dim() const {
+   return view_.dim();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ImageView MipmapImage::view() const {
+   return view_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vec4* MipmapImage::line(I32 y, I32 z) const {
+   return reinterpret_cast<vec4*>(view_.data() + z * view_.plane_span() + y * view_.line_span());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool load_mipmap_image(const ConstImageView& src, MipmapImage& dest) {
+   dest = MipmapImage(src.dim());
+   if (is_compressed(src.format().packing())) {
+      return decode_image(src, dest.view());
+   }
+
+   blit_texels(src, ivec3(0), dest.view(), ivec3(0), src.dim());
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool store_mipmap_image(const MipmapImage& src, const ImageView& dest, EncodeQuality quality) {
+   if (is_compressed(dest.format().packing())) {
+      return encode_image(src.view(), dest, quality);
+   }
+
+   blit_texels(src.view(), ivec3(0), dest, ivec3(0), glm::min(src.dim(), dest.dim()));
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void downsample_rows(const MipmapImage& src, const MipmapImage& dest, MipmapFilter filter, I32 y_begin, I32 y_end, bool clamp_negative) {
+   const ivec3 src_dim = src.dim();
+   const ivec3 dest_dim = dest.dim();
+   y_end = std::min(y_end, dest_dim.y);
+   if (y_begin >= y_end) {
+      return;
+   }
+
+   const axis_taps_ x_taps = make_axis_taps(filter, src_dim.x, dest_dim.x);
+   const axis_taps_ y_taps = make_axis_taps(filter, src_dim.y, dest_dim.y);
+   const axis_taps_ z_taps = make_axis_taps(filter, src_dim.z, dest_dim.z);
+
+   // Source rows needed by this band are filtered horizontally once per source
+   // plane, then combined vertically into each destination row.
+   I32 src_y_min = src_dim.y;
+   I32 src_y_max = 0;
+   for (I32 y = y_begin; y < y_end; ++y) {
+      for (const tap_* tap = y_taps.begin(y); tap != y_taps.end(y); ++tap) {
+         src_y_min = std::min(src_y_min, tap->index);
+         src_y_max = std::max(src_y_max, tap->index);
+      }
+   }
+
+   const std::size_t row_size = std::size_t(dest_dim.x);
+   std::vector<vec4> rows(row_size * std::size_t(src_y_max - src_y_min + 1));
+
+   for (I32 z = 0; z < dest_dim.z; ++z) {
+      for (I32 y = y_begin; y < y_end; ++y) {
+         std::fill_n(dest.line(y, z), row_size, vec4(0.f));
+      }
+
+      for (const tap_* z_tap = z_taps.begin(z); z_tap != z_taps.end(z); ++z_tap) {
+         for (I32 sy = src_y_min; sy <= src_y_max; ++sy) {
+            const vec4* src_line = src.line(sy, z_tap->index);
+            vec4* row = rows.data() + std::size_t(sy - src_y_min) * row_size;
+            for (I32 x = 0; x < dest_dim.x; ++x) {
+               vec4 sum = vec4(0.f);
+               for (const tap_* tap = x_taps.begin(x); tap != x_taps.end(x); ++tap) {
+                  sum += src_line[tap->index] * tap->weight;
+               }
+               row[x] = sum;
+            }
+         }
+
+         for (I32 y = y_begin; y < y_end; ++y) {
+            vec4* dest_line = dest.line(y, z);
+            for (const tap_* tap = y_taps.begin(y); tap != y_taps.end(y); ++tap) {
+               const vec4* row = rows.data() + std::size_t(tap->index - src_y_min) * row_size;
+               const float weight = tap->weight * z_tap->weight;
+               for (I32 x = 0; x < dest_dim.x; ++x) {
+                  dest_line[x] += row[x] * weight;
+               }
+            }
+         }
+      }
+
+      if (clamp_negative) {
+         for (I32 y = y_begin; y < y_end; ++y) {
+            vec4* dest_line = dest.line(y, z);
+            for (I32 x = 0; x < dest_dim.x; ++x) {
+               dest_line[x] = glm::max(dest_line[x], vec4(0.f));
+            }
+         }
+      }
+   }
+}
+
+} // be::tools
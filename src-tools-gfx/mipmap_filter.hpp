@@ -0,0 +1,53 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_MIPMAP_FILTER_HPP_
+#define BE_TOOLS_GFX_MIPMAP_FILTER_HPP_
+
+#include "block_codec.hpp"
+#include <be/gfx/tex/texture.hpp>
+#include <memory>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+enum class MipmapFilter : U8 {
+   none = 0,
+   box,     // area average
+   kaiser,  // Kaiser windowed sinc, radius 3
+   lanczos  // Lanczos-3
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A linear, premultiplied, 32-bit float RGBA copy of one image.
+///
+/// \details Mipmaps are filtered in this format so that sRGB and straight
+///         alpha textures are averaged correctly; conversion to and from the
+///         texture's own format is done by blit_texels.
+class MipmapImage final {
+public:
+   MipmapImage() = default;
+   explicit MipmapImage(ivec3 dim);
+
+   ivec3 dim() const;
+   gfx::tex::ImageView view() const;
+   vec4* line(I32 y, I32 z) const;
+
+private:
+   std::unique_ptr<gfx::tex::TextureStorage> storage_;
+   gfx::tex::ImageView view_;
+};
+
+bool load_mipmap_image(const gfx::tex::ConstImageView& src, MipmapImage& dest);
+bool store_mipmap_image(const MipmapImage& src, const gfx::tex::ImageView& dest, EncodeQuality quality);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Filters rows [y_begin, y_end) of every plane of dest from src.
+///
+/// \details Each axis is resampled independently, so dest may be smaller than
+///         src by any factor.  Separate row ranges may be filtered
+///         concurrently.  If clamp_negative is set, negative lobes of the
+///         filter are clipped, which unsigned formats would do anyway.
+void downsample_rows(const MipmapImage& src, const MipmapImage& dest, MipmapFilter filter, I32 y_begin, I32 y_end, bool clamp_negative);
+
+} // be::tools
+
+#endif
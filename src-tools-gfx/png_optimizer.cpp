@@ -0,0 +1,746 @@
+#include "png_optimizer.hpp"
+#include "worker_pool.hpp"
+#include <zlib/zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace be::tools {
+namespace {
+
+const UC png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+constexpr int adaptive_filter = 5;
+
+///////////////////////////////////////////////////////////////////////////////
+// Every sample is kept in a U16, whether the image has 8 or 16 bit samples.
+struct raw_image_ {
+   U32 width = 0;
+   U32 height = 0;
+   bool wide = false;
+   std::vector<U16> rgba;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// One possible representation of an image: its color type, bit depth,
+// palette, and packed but unfiltered scanlines.
+struct candidate_ {
+   UC color_type = 6;
+   UC bit_depth = 8;
+   std::vector<UC> plte;
+   std::vector<UC> trns;
+   std::size_t row_bytes = 0;
+   std::size_t filter_bpp = 4;
+   std::vector<UC> rows;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct chunk_ {
+   char type[4];
+   std::vector<UC> data;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Ancillary chunks which stay valid whatever the color type and bit depth.
+struct kept_chunks_ {
+   std::vector<chunk_> before_plte;
+   std::vector<chunk_> before_idat;
+   std::vector<chunk_> after_idat;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+U32 get_u32_be(const UC* ptr) {
+   return (U32(ptr[0]) << 24) | (U32(ptr[1]) << 16) | (U32(ptr[2]) << 8) | U32(ptr[3]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void put_u32_be(std::vector<UC>& out, U32 value) {
+   out.push_back(UC(value >> 24));
+   out.push_back(UC(value >> 16));
+   out.push_back(UC(value >> 8));
+   out.push_back(UC(value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void put_chunk(std::vector<UC>& out, const char* type, const UC* data, std::size_t size) {
+   put_u32_be(out, U32(size));
+   const std::size_t type_offset = out.size();
+   out.insert(out.end(), type, type + 4);
+   out.insert(out.end(), data, data + size);
+   put_u32_be(out, U32(crc32(crc32(0, Z_NULL, 0), out.data() + type_offset, uInt(size + 4))));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void put_chunks(std::vector<UC>& out, const std::vector<chunk_>& chunks) {
+   for (const chunk_& chunk : chunks) {
+      put_chunk(out, chunk.type, chunk.data.data(), chunk.data.size());
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t channels(UC color_type) {
+   switch (color_type) {
+      case 0: return 1;
+      case 2: return 3;
+      case 3: return 1;
+      case 4: return 2;
+      case 6: return 4;
+      default: return 0;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+UC paeth(UC a, UC b, UC c) {
+   const int p = int(a) + int(b) - int(c);
+   const int pa = std::abs(p - int(a));
+   const int pb = std::abs(p - int(b));
+   const int pc = std::abs(p - int(c));
+   if (pa <= pb && pa <= pc) {
+      return a;
+   } else if (pb <= pc) {
+      return b;
+   }
+   return c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes the row with the given filter type into dest and returns the sum of
+// the filtered bytes as signed values, the usual heuristic for choosing one.
+std::size_t filter_row(int type, const UC* row, const UC* prev, std::size_t size, std::size_t bpp, UC* dest) {
+   std::size_t cost = 0;
+   for (std::size_t i = 0; i < size; ++i) {
+      const UC a = i >= bpp ? row[i - bpp] : 0;
+      const UC b = prev ? prev[i] : 0;
+      const UC c = i >= bpp && prev ? prev[i - bpp] : 0;
+      UC value = row[i];
+      switch (type) {
+         case 1: value = UC(value - a); break;
+         case 2: value = UC(value - b); break;
+         case 3: value = UC(value - ((int(a) + int(b)) >> 1)); break;
+         case 4: value = UC(value - paeth(a, b, c)); break;
+         default: break;
+      }
+      dest[i] = value;
+      cost += value < 128 ? value : 256 - value;
+   }
+   return cost;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void unfilter_row(UC type, UC* row, const UC* prev, std::size_t size, std::size_t bpp) {
+   for (std::size_t i = 0; i < size; ++i) {
+      const UC a = i >= bpp ? row[i - bpp] : 0;
+      const UC b = prev ? prev[i] : 0;
+      const UC c = i >= bpp && prev ? prev[i - bpp] : 0;
+      switch (type) {
+         case 1: row[i] = UC(row[i] + a); break;
+         case 2: row[i] = UC(row[i] + b); break;
+         case 3: row[i] = UC(row[i] + ((int(a) + int(b)) >> 1)); break;
+         case 4: row[i] = UC(row[i] + paeth(a, b, c)); break;
+         default: break;
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> filter_rows(const candidate_& c, U32 height, int filter) {
+   std::vector<UC> result((c.row_bytes + 1) * height);
+   std::vector<UC> scratch(filter == adaptive_filter ? c.row_bytes : 0);
+   for (std::size_t y = 0; y < height; ++y) {
+      const UC* row = c.rows.data() + y * c.row_bytes;
+      const UC* prev = y > 0 ? row - c.row_bytes : nullptr;
+      UC* dest = result.data() + y * (c.row_bytes + 1);
+
+      if (filter != adaptive_filter) {
+         dest[0] = UC(filter);
+         filter_row(filter, row, prev, c.row_bytes, c.filter_bpp, dest + 1);
+         continue;
+      }
+
+      dest[0] = 0;
+      std::size_t best = filter_row(0, row, prev, c.row_bytes, c.filter_bpp, dest + 1);
+      for (int type = 1; type <= 4; ++type) {
+         const std::size_t cost = filter_row(type, row, prev, c.row_bytes, c.filter_bpp, scratch.data());
+         if (cost < best) {
+            best = cost;
+            dest[0] = UC(type);
+            std::memcpy(dest + 1, scratch.data(), c.row_bytes);
+         }
+      }
+   }
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> deflate_data(const std::vector<UC>& data, int strategy) {
+   z_stream stream {};
+   if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15, 9, strategy) != Z_OK) {
+      throw std::runtime_error("Failed to initialize zlib!");
+   }
+
+   std::vector<UC> result(deflateBound(&stream, uLong(data.size())));
+   stream.next_in = const_cast<Bytef*>(data.data());
+   stream.avail_in = uInt(data.size());
+   stream.next_out = result.data();
+   stream.avail_out = uInt(result.size());
+   const int status = deflate(&stream, Z_FINISH);
+   result.resize(stream.total_out);
+   deflateEnd(&stream);
+
+   if (status != Z_STREAM_END) {
+      throw std::runtime_error("Failed to compress PNG image data!");
+   }
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the smallest zlib stream for one filter strategy, over each of the
+// given zlib strategies.
+std::vector<UC> compress_candidate(const candidate_& c, U32 height, int filter, const std::vector<int>& strategies) {
+   const std::vector<UC> filtered = filter_rows(c, height, filter);
+   std::vector<UC> best;
+   for (int strategy : strategies) {
+      std::vector<UC> compressed = deflate_data(filtered, strategy);
+      if (best.empty() || compressed.size() < best.size()) {
+         best = std::move(compressed);
+      }
+   }
+   return best;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> assemble_png(const candidate_& c, U32 width, U32 height, const kept_chunks_& chunks, const std::vector<UC>& idat) {
+   std::vector<UC> result;
+   result.reserve(sizeof(png_signature) + 64 + c.plte.size() + c.trns.size() + idat.size());
+   result.insert(result.end(), png_signature, png_signature + sizeof(png_signature));
+
+   std::vector<UC> header;
+   put_u32_be(header, width);
+   put_u32_be(header, height);
+   header.push_back(c.bit_depth);
+   header.push_back(c.color_type);
+   header.push_back(0); // deflate
+   header.push_back(0); // adaptive filtering
+   header.push_back(0); // not interlaced
+   put_chunk(result, "IHDR", header.data(), header.size());
+
+   put_chunks(result, chunks.before_plte);
+   if (!c.plte.empty()) {
+      put_chunk(result, "PLTE", c.plte.data(), c.plte.size());
+   }
+   if (!c.trns.empty()) {
+      put_chunk(result, "tRNS", c.trns.data(), c.trns.size());
+   }
+   put_chunks(result, chunks.before_idat);
+   put_chunk(result, "IDAT", idat.data(), idat.size());
+   put_chunks(result, chunks.after_idat);
+   put_chunk(result, "IEND", nullptr, 0);
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Packs samples of the given bit depth, most significant bits first.
+void pack_rows(candidate_& c, const raw_image_& image, const std::vector<U16>& samples) {
+   const std::size_t n_channels = channels(c.color_type);
+   c.row_bytes = (std::size_t(image.width) * n_channels * c.bit_depth + 7) / 8;
+   c.filter_bpp = std::max<std::size_t>(1, n_channels * c.bit_depth / 8);
+   c.rows.assign(c.row_bytes * image.height, 0);
+
+   const std::size_t row_samples = std::size_t(image.width) * n_channels;
+   for (std::size_t y = 0; y < image.height; ++y) {
+      const U16* src = samples.data() + y * row_samples;
+      UC* dest = c.rows.data() + y * c.row_bytes;
+      if (c.bit_depth == 16) {
+         for (std::size_t i = 0; i < row_samples; ++i) {
+            dest[i * 2] = UC(src[i] >> 8);
+            dest[i * 2 + 1] = UC(src[i]);
+         }
+      } else if (c.bit_depth == 8) {
+         for (std::size_t i = 0; i < row_samples; ++i) {
+            dest[i] = UC(src[i]);
+         }
+      } else {
+         const std::size_t per_byte = 8 / c.bit_depth;
+         for (std::size_t i = 0; i < row_samples; ++i) {
+            const std::size_t shift = 8 - c.bit_depth * (i % per_byte + 1);
+            dest[i / per_byte] |= UC(src[i] << shift);
+         }
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Grayscale or truecolor, with alpha only if some texel isn't opaque.
+candidate_ make_direct_candidate(const raw_image_& image, bool gray, bool opaque) {
+   candidate_ c;
+   c.color_type = UC((gray ? 0 : 2) | (opaque ? 0 : 4));
+   c.bit_depth = image.wide ? 16 : 8;
+
+   const std::size_t n_channels = channels(c.color_type);
+   const std::size_t n_texels = std::size_t(image.width) * image.height;
+   const U16 max_value = image.wide ? 0xFFFF : 0xFF;
+   std::vector<U16> samples(n_texels * n_channels);
+   U16* dest = samples.data();
+   for (std::size_t i = 0; i < n_texels; ++i) {
+      const U16* src = image.rgba.data() + i * 4;
+      *dest++ = src[0];
+      if (!gray) {
+         *dest++ = src[1];
+         *dest++ = src[2];
+      }
+      if (!opaque) {
+         *dest++ = src[3];
+      }
+   }
+
+   // Opaque grayscale can use 1, 2, or 4 bits if every value is an exact multiple of the smaller depth's step.
+   if (gray && opaque && !image.wide) {
+      for (UC depth : { UC(1), UC(2), UC(4) }) {
+         const U16 step = U16(max_value / ((1 << depth) - 1));
+         if (std::all_of(samples.begin(), samples.end(), [step](U16 v) { return v % step == 0; })) {
+            for (U16& v : samples) {
+               v = U16(v / step);
+            }
+            c.bit_depth = depth;
+            break;
+         }
+      }
+   }
+
+   pack_rows(c, image, samples);
+   return c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Palette entries with alpha come first so that tRNS can stop early.
+bool make_palette_candidate(const raw_image_& image, candidate_& c) {
+   const std::size_t n_texels = std::size_t(image.width) * image.height;
+   std::unordered_map<U32, std::size_t> counts;
+   for (std::size_t i = 0; i < n_texels; ++i) {
+      const U16* src = image.rgba.data() + i * 4;
+      ++counts[(U32(src[0]) << 24) | (U32(src[1]) << 16) | (U32(src[2]) << 8) | U32(src[3])];
+      if (counts.size() > 256) {
+         return false;
+      }
+   }
+
+   std::vector<std::pair<U32, std::size_t>> colors(counts.begin(), counts.end());
+   std::sort(colors.begin(), colors.end(), [](const auto& a, const auto& b) {
+      const bool a_opaque = (a.first & 0xFF) == 0xFF;
+      const bool b_opaque = (b.first & 0xFF) == 0xFF;
+      if (a_opaque != b_opaque) {
+         return b_opaque;
+      }
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+   });
+
+   std::unordered_map<U32, U16> indices;
+   c = candidate_();
+   c.color_type = 3;
+   for (const auto& color : colors) {
+      indices[color.first] = U16(indices.size());
+      c.plte.push_back(UC(color.first >> 24));
+      c.plte.push_back(UC(color.first >> 16));
+      c.plte.push_back(UC(color.first >> 8));
+      if ((color.first & 0xFF) != 0xFF) {
+         c.trns.push_back(UC(color.first));
+      }
+   }
+
+   const std::size_t n_colors = colors.size();
+   c.bit_depth = n_colors <= 2 ? 1 : n_colors <= 4 ? 2 : n_colors <= 16 ? 4 : 8;
+
+   std::vector<U16> samples(n_texels);
+   for (std::size_t i = 0; i < n_texels; ++i) {
+      const U16* src = image.rgba.data() + i * 4;
+      samples[i] = indices[(U32(src[0]) << 24) | (U32(src[1]) << 16) | (U32(src[2]) << 8) | U32(src[3])];
+   }
+
+   pack_rows(c, image, samples);
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t estimated_size(const candidate_& c, U32 height) {
+   return (c.row_bytes + 1) * height + c.plte.size() + c.trns.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<candidate_> make_candidates(raw_image_& image, bool allow_gray, bool allow_color, U8 effort) {
+   const std::size_t n_samples = image.rgba.size();
+   if (image.wide && std::all_of(image.rgba.begin(), image.rgba.end(), [](U16 v) { return (v >> 8) == (v & 0xFF); })) {
+      for (std::size_t i = 0; i < n_samples; ++i) {
+         image.rgba[i] >>= 8;
+      }
+      image.wide = false;
+   }
+
+   const U16 max_value = image.wide ? 0xFFFF : 0xFF;
+   bool gray = true;
+   bool opaque = true;
+   for (std::size_t i = 0; i < n_samples; i += 4) {
+      const U16* src = image.rgba.data() + i;
+      gray = gray && src[0] == src[1] && src[0] == src[2];
+      opaque = opaque && src[3] == max_value;
+   }
+
+   std::vector<candidate_> result;
+   result.push_back(make_direct_candidate(image, gray && allow_gray, opaque));
+
+   candidate_ palette;
+   if (!image.wide && allow_color && make_palette_candidate(image, palette)) {
+      result.push_back(std::move(palette));
+   }
+
+   if (effort < 2 && result.size() > 1) {
+      const U32 height = image.height;
+      auto best = std::min_element(result.begin(), result.end(), [height](const candidate_& a, const candidate_& b) {
+         return estimated_size(a, height) < estimated_size(b, height);
+      });
+      candidate_ c = std::move(*best);
+      result.clear();
+      result.push_back(std::move(c));
+   }
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Shared with the pool tasks helping to compress a set of variants, which
+// may not start until encode_candidates has already returned.
+struct compress_state_ {
+   struct variant_ {
+      const candidate_* candidate;
+      int filter;
+      std::vector<UC> idat;
+      std::exception_ptr exception;
+   };
+
+   U32 height;
+   std::vector<int> strategies;
+   std::vector<variant_> variants;
+   std::atomic<std::size_t> next = 0;
+   std::size_t completed = 0;
+   std::mutex mutex;
+   std::condition_variable cv;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void compress_variants(compress_state_& state) {
+   for (std::size_t i; (i = state.next++) < state.variants.size(); ) {
+      compress_state_::variant_& v = state.variants[i];
+      try {
+         v.idat = compress_candidate(*v.candidate, state.height, v.filter, state.strategies);
+      } catch (...) {
+         v.exception = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (++state.completed == state.variants.size()) {
+         state.cv.notify_all();
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Indexed and sub-byte images rarely benefit from filtering; everything else
+// uses the adaptive heuristic unless every strategy is being tried.
+std::vector<UC> encode_candidates(const std::vector<candidate_>& candidates, U32 width, U32 height, const kept_chunks_& chunks, U8 effort, WorkerPool* pool) {
+   auto state = std::make_shared<compress_state_>();
+   state->height = height;
+   state->strategies = { Z_DEFAULT_STRATEGY };
+   if (effort >= 3) {
+      state->strategies.push_back(Z_FILTERED);
+      state->strategies.push_back(Z_RLE);
+   }
+
+   for (const candidate_& c : candidates) {
+      std::vector<int> filters;
+      if (effort >= 2) {
+         filters = { 0, 1, 2, 3, 4, adaptive_filter };
+      } else {
+         filters = { c.color_type == 3 || c.bit_depth < 8 ? 0 : adaptive_filter };
+      }
+
+      for (int filter : filters) {
+         state->variants.push_back(compress_state_::variant_ { &c, filter, { }, { } });
+      }
+   }
+
+   // The caller is usually a pool worker itself, so it compresses variants too rather than waiting on helpers
+   // that may be queued behind it.  Helpers which start late find nothing left to claim and return immediately,
+   // so only variants which have actually been claimed are waited for.
+   if (pool && effort >= 2) {
+      const std::size_t threads = std::min(pool->size(), state->variants.size());
+      for (std::size_t i = 1; i < threads; ++i) {
+         pool->submit([state]() { compress_variants(*state); });
+      }
+   }
+   compress_variants(*state);
+   {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->cv.wait(lock, [&]() { return state->completed == state->variants.size(); });
+   }
+
+   std::vector<UC> best;
+   for (compress_state_::variant_& v : state->variants) {
+      if (v.exception) {
+         std::rethrow_exception(v.exception);
+      }
+      std::vector<UC> png = assemble_png(*v.candidate, width, height, chunks, v.idat);
+      if (best.empty() || png.size() < best.size()) {
+         best = std::move(png);
+      }
+   }
+
+   return best;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool is_kept_chunk(const char* type) {
+   static const char* const kept[] = { "gAMA", "cHRM", "sRGB", "iCCP", "pHYs", "tEXt", "zTXt", "iTXt", "tIME", "eXIf" };
+   static const char* const dropped[] = { "bKGD", "sBIT", "hIST", "sPLT" };
+   for (const char* name : kept) {
+      if (std::memcmp(type, name, 4) == 0) {
+         return true;
+      }
+   }
+   for (const char* name : dropped) {
+      if (std::memcmp(type, name, 4) == 0) {
+         return false;
+      }
+   }
+   // Unknown ancillary chunks may be copied only if they are marked safe-to-copy.
+   return (type[3] & 0x20) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool decode_png(const std::vector<UC>& png, raw_image_& image, kept_chunks_& chunks, UC& color_type, bool& has_iccp) {
+   if (png.size() < sizeof(png_signature) || std::memcmp(png.data(), png_signature, sizeof(png_signature)) != 0) {
+      return false;
+   }
+
+   U32 width = 0;
+   U32 height = 0;
+   UC bit_depth = 0;
+   std::vector<UC> plte;
+   std::vector<UC> trns;
+   std::vector<UC> idat;
+   bool seen_ihdr = false;
+   bool seen_plte = false;
+   bool seen_iend = false;
+   has_iccp = false;
+
+   std::size_t offset = sizeof(png_signature);
+   while (!seen_iend) {
+      if (png.size() - offset < 12) {
+         return false;
+      }
+      const U32 length = get_u32_be(png.data() + offset);
+      if (length > png.size() - offset - 12) {
+         return false;
+      }
+
+      const UC* type_ptr = png.data() + offset + 4;
+      const UC* data = type_ptr + 4;
+      if (get_u32_be(data + length) != U32(crc32(crc32(0, Z_NULL, 0), type_ptr, uInt(length + 4)))) {
+         return false;
+      }
+
+      char type[4];
+      std::memcpy(type, type_ptr, 4);
+      offset += 12 + std::size_t(length);
+
+      if (std::memcmp(type, "IHDR", 4) == 0) {
+         if (length != 13 || seen_ihdr) {
+            return false;
+         }
+         width = get_u32_be(data);
+         height = get_u32_be(data + 4);
+         bit_depth = data[8];
+         color_type = data[9];
+         if (data[10] != 0 || data[11] != 0 || data[12] != 0) {
+            return false; // interlaced or non-standard
+         }
+         seen_ihdr = true;
+      } else if (!seen_ihdr) {
+         return false;
+      } else if (std::memcmp(type, "PLTE", 4) == 0) {
+         plte.assign(data, data + length);
+         seen_plte = true;
+      } else if (std::memcmp(type, "tRNS", 4) == 0) {
+         trns.assign(data, data + length);
+      } else if (std::memcmp(type, "IDAT", 4) == 0) {
+         idat.insert(idat.end(), data, data + length);
+      } else if (std::memcmp(type, "IEND", 4) == 0) {
+         seen_iend = true;
+      } else if ((type[0] & 0x20) == 0) {
+         return false; // unknown critical chunk
+      } else if (is_kept_chunk(type)) {
+         has_iccp = has_iccp || std::memcmp(type, "iCCP", 4) == 0;
+         chunk_ chunk;
+         std::memcpy(chunk.type, type, 4);
+         chunk.data.assign(data, data + length);
+         if (!idat.empty()) {
+            chunks.after_idat.push_back(std::move(chunk));
+         } else if (seen_plte) {
+            chunks.before_idat.push_back(std::move(chunk));
+         } else {
+            chunks.before_plte.push_back(std::move(chunk));
+         }
+      }
+   }
+
+   const std::size_t n_channels = channels(color_type);
+   const bool valid_depth = color_type == 0 ? (bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8 || bit_depth == 16)
+      : color_type == 3 ? (bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8)
+      : (bit_depth == 8 || bit_depth == 16);
+   if (n_channels == 0 || !valid_depth || width == 0 || height == 0 || (color_type == 3 && plte.empty())) {
+      return false;
+   }
+
+   const std::size_t row_bytes = (std::size_t(width) * n_channels * bit_depth + 7) / 8;
+   const std::size_t bpp = std::max<std::size_t>(1, n_channels * bit_depth / 8);
+   uLongf raw_size = uLongf((row_bytes + 1) * height);
+   std::vector<UC> raw(raw_size);
+   if (uncompress(raw.data(), &raw_size, idat.data(), uLong(idat.size())) != Z_OK || raw_size != raw.size()) {
+      return false;
+   }
+
+   for (std::size_t y = 0; y < height; ++y) {
+      UC* row = raw.data() + y * (row_bytes + 1);
+      if (row[0] > 4) {
+         return false;
+      }
+      unfilter_row(row[0], row + 1, y > 0 ? row - row_bytes : nullptr, row_bytes, bpp);
+   }
+
+   image.width = width;
+   image.height = height;
+   image.wide = bit_depth == 16;
+   image.rgba.resize(std::size_t(width) * height * 4);
+
+   const U16 max_value = image.wide ? 0xFFFF : 0xFF;
+   const U16 max_sample = U16((1u << bit_depth) - 1);
+   std::vector<U16> samples(std::size_t(width) * n_channels);
+   for (std::size_t y = 0; y < height; ++y) {
+      const UC* row = raw.data() + y * (row_bytes + 1) + 1;
+      for (std::size_t i = 0; i < samples.size(); ++i) {
+         if (bit_depth == 16) {
+            samples[i] = U16((U16(row[i * 2]) << 8) | row[i * 2 + 1]);
+         } else if (bit_depth == 8) {
+            samples[i] = row[i];
+         } else {
+            const std::size_t per_byte = 8 / bit_depth;
+            const std::size_t shift = 8 - bit_depth * (i % per_byte + 1);
+            samples[i] = U16((row[i / per_byte] >> shift) & max_sample);
+         }
+      }
+
+      U16* dest = image.rgba.data() + y * std::size_t(width) * 4;
+      for (std::size_t x = 0; x < width; ++x, dest += 4) {
+         const U16* src = samples.data() + x * n_channels;
+         switch (color_type) {
+            case 0:
+            {
+               const U16 v = bit_depth < 8 ? U16(src[0] * (0xFF / max_sample)) : src[0];
+               const bool transparent = trns.size() >= 2 && src[0] == ((U16(trns[0]) << 8) | trns[1]);
+               dest[0] = dest[1] = dest[2] = v;
+               dest[3] = transparent ? 0 : max_value;
+               break;
+            }
+            case 2:
+            {
+               const bool transparent = trns.size() >= 6
+                  && src[0] == ((U16(trns[0]) << 8) | trns[1])
+                  && src[1] == ((U16(trns[2]) << 8) | trns[3])
+                  && src[2] == ((U16(trns[4]) << 8) | trns[5]);
+               dest[0] = src[0];
+               dest[1] = src[1];
+               dest[2] = src[2];
+               dest[3] = transparent ? 0 : max_value;
+               break;
+            }
+            case 3:
+            {
+               const std::size_t index = src[0];
+               if (index * 3 + 2 >= plte.size()) {
+                  return false;
+               }
+               dest[0] = plte[index * 3];
+               dest[1] = plte[index * 3 + 1];
+               dest[2] = plte[index * 3 + 2];
+               dest[3] = index < trns.size() ? trns[index] : 0xFF;
+               break;
+            }
+            case 4:
+               dest[0] = dest[1] = dest[2] = src[0];
+               dest[3] = src[1];
+               break;
+            default:
+               dest[0] = src[0];
+               dest[1] = src[1];
+               dest[2] = src[2];
+               dest[3] = src[3];
+               break;
+         }
+      }
+   }
+
+   return true;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<UC> encode_rgba8_png(const UC* texels, U32 width, U32 height, U8 effort, WorkerPool* pool) {
+   raw_image_ image;
+   image.width = width;
+   image.height = height;
+   image.rgba.assign(texels, texels + std::size_t(width) * height * 4);
+
+   std::vector<candidate_> candidates;
+   if (effort == 0) {
+      candidates.emplace_back();
+      pack_rows(candidates.back(), image, image.rgba);
+   } else {
+      candidates = make_candidates(image, true, true, effort);
+   }
+
+   return encode_candidates(candidates, width, height, kept_chunks_(), effort, pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool optimize_png(std::vector<UC>& png, U8 effort, WorkerPool* pool) {
+   if (effort == 0) {
+      return false;
+   }
+
+   raw_image_ image;
+   kept_chunks_ chunks;
+   UC color_type = 0;
+   bool has_iccp = false;
+   if (!decode_png(png, image, chunks, color_type, has_iccp)) {
+      return false;
+   }
+
+   // An ICC profile is only valid for the color type family it was written for.
+   const bool was_gray = color_type == 0 || color_type == 4;
+   const std::vector<candidate_> candidates = make_candidates(image, !has_iccp || was_gray, !has_iccp || !was_gray, effort);
+
+   std::vector<UC> result = encode_candidates(candidates, image.width, image.height, chunks, effort, pool);
+   if (result.empty() || result.size() >= png.size()) {
+      return false;
+   }
+
+   png = std::move(result);
+   return true;
+}
+
+} // be::tools
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_PNG_OPTIMIZER_HPP_
+#define BE_TOOLS_GFX_PNG_OPTIMIZER_HPP_
+
+#include <be/core/be.hpp>
+#include <vector>
+
+namespace be::tools {
+
+class WorkerPool;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The highest meaningful --png-effort.
+///
+/// \details 0 uses one adaptive filter pass and zlib level 9.  1 also picks
+///         the smallest lossless color type and bit depth (grayscale,
+///         dropped alpha, palettes, and sub-byte depths).  2 tries every
+///         candidate color type with every scanline filter strategy, and
+///         3 additionally tries several zlib strategies for each.  The
+///         smallest encoding is always kept.  At effort 2 and above, the
+///         variants are compressed on the calling thread and on up to
+///         pool->size() - 1 of the pool's workers, if a pool is given.
+constexpr U8 max_png_effort = 3;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes 8-bit straight alpha RGBA texels, top row first, as a
+///         PNG file.
+std::vector<UC> encode_rgba8_png(const UC* texels, U32 width, U32 height, U8 effort, WorkerPool* pool = nullptr);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Losslessly re-encodes a PNG file in place if a smaller encoding
+///         can be found at the given effort.
+///
+/// \details Returns false and leaves png untouched if it is already the
+///         smallest found, is interlaced, or can't be parsed.  Color
+///         management and text chunks are kept; chunks which depend on the
+///         color type (bKGD, sBIT, hIST, sPLT) and unknown chunks which are
+///         not safe to copy are dropped.
+bool optimize_png(std::vector<UC>& png, U8 effort, WorkerPool* pool = nullptr);
+
+} // be::tools
+
+#endif
@@ -0,0 +1,187 @@
+#include "profiler.hpp"
+#include "json_writer.hpp"
+#include <be/core/logging.hpp>
+#include <ostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace be::tools {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+double to_ms(Profiler::clock::duration duration) {
+   return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+double to_mb_per_s(U64 bytes, Profiler::clock::duration duration) {
+   const double seconds = std::chrono::duration<double>(duration).count();
+   return seconds > 0 ? double(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+const char* profile_phase_name(ProfilePhase phase) noexcept {
+   switch (phase) {
+      case ProfilePhase::glob:     return "glob";
+      case ProfilePhase::read:     return "read";
+      case ProfilePhase::parse:    return "parse";
+      case ProfilePhase::allocate: return "allocate";
+      case ProfilePhase::blit:     return "blit";
+      case ProfilePhase::mipmap:   return "mipmap";
+      case ProfilePhase::write:    return "write";
+      default:                     return "?";
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Profiler::Profiler()
+   : start_(clock::now()) { }
+
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::record(ProfilePhase phase, S subject, clock::duration duration, U64 bytes) {
+   std::lock_guard<std::mutex> lock(mutex_);
+   events_.push_back(event_ { phase, std::move(subject), duration, bytes });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Profiler::totals_type Profiler::totals_() const {
+   totals_type totals;
+   for (const event_& event : events_) {
+      phase_total_& total = totals[std::size_t(event.phase)];
+      ++total.count;
+      total.duration += event.duration;
+      total.bytes += event.bytes;
+   }
+   return totals;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::log_summary() const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   const totals_type totals = totals_();
+
+   be_info() << "Profile summary"
+      & attr("Wall Time (ms)") << to_ms(clock::now() - start_)
+      & attr("Peak RSS (MB)") << double(peak_rss_bytes()) / (1024.0 * 1024.0)
+      | default_log();
+
+   for (std::size_t p = 0; p < std::size_t(ProfilePhase::count); ++p) {
+      const phase_total_& total = totals[p];
+      if (total.count > 0) {
+         be_info() << "Profile phase"
+            & attr("Phase") << profile_phase_name(ProfilePhase(p))
+            & attr("Count") << total.count
+            & attr("Time (ms)") << to_ms(total.duration)
+            & attr("Size (MB)") << double(total.bytes) / (1024.0 * 1024.0)
+            & attr("Throughput (MB/s)") << to_mb_per_s(total.bytes, total.duration)
+            | default_log();
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Profiler::write_json(std::ostream& os) const {
+   std::lock_guard<std::mutex> lock(mutex_);
+   const totals_type totals = totals_();
+
+   os << "{\n  \"wall_ms\": " << to_ms(clock::now() - start_)
+      << ",\n  \"peak_rss_bytes\": " << peak_rss_bytes()
+      << ",\n  \"phases\": {";
+
+   bool first = true;
+   for (std::size_t p = 0; p < std::size_t(ProfilePhase::count); ++p) {
+      const phase_total_& total = totals[p];
+      if (total.count == 0) {
+         continue;
+      }
+      os << (first ? "\n    " : ",\n    ");
+      first = false;
+      write_json_string(os, profile_phase_name(ProfilePhase(p)));
+      os << ": { \"count\": " << total.count
+         << ", \"ms\": " << to_ms(total.duration)
+         << ", \"bytes\": " << total.bytes
+         << ", \"mb_per_s\": " << to_mb_per_s(total.bytes, total.duration) << " }";
+   }
+
+   os << "\n  },\n  \"events\": [";
+   first = true;
+   for (const event_& event : events_) {
+      os << (first ? "\n    " : ",\n    ");
+      first = false;
+      os << "{ \"phase\": ";
+      write_json_string(os, profile_phase_name(event.phase));
+      if (!event.subject.empty()) {
+         os << ", \"subject\": ";
+         write_json_string(os, event.subject);
+      }
+      os << ", \"ms\": " << to_ms(event.duration)
+         << ", \"bytes\": " << event.bytes
+         << ", \"mb_per_s\": " << to_mb_per_s(event.bytes, event.duration) << " }";
+   }
+   os << "\n  ]\n}\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ProfileScope::ProfileScope(Profiler* profiler, ProfilePhase phase, S subject)
+   : profiler_(profiler),
+     phase_(phase) {
+   if (profiler_) {
+      subject_ = std::move(subject);
+      start_ = Profiler::clock::now();
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ProfileScope::~ProfileScope() {
+   if (profiler_) {
+      profiler_->record(phase_, std::move(subject_), Profiler::clock::now() - start_, bytes_);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ProfileScope::bytes(U64 bytes) noexcept {
+   bytes_ = bytes;
+}
+
+#ifdef _WIN32
+
+///////////////////////////////////////////////////////////////////////////////
+U64 peak_rss_bytes() noexcept {
+   PROCESS_MEMORY_COUNTERS counters;
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+      return 0;
+   }
+   return U64(counters.PeakWorkingSetSize);
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////
+U64 peak_rss_bytes() noexcept {
+   struct rusage usage;
+   if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+      return 0;
+   }
+#ifdef __APPLE__
+   return U64(usage.ru_maxrss);
+#else
+   return U64(usage.ru_maxrss) * 1024u;
+#endif
+}
+
+#endif
+
+} // be::tools
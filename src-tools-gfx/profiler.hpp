@@ -0,0 +1,91 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_PROFILER_HPP_
+#define BE_TOOLS_GFX_PROFILER_HPP_
+
+#include <be/core/be.hpp>
+#include <array>
+#include <chrono>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+enum class ProfilePhase : U8 {
+   glob = 0,
+   read,
+   parse,
+   allocate,
+   blit,
+   mipmap,
+   write,
+   count
+};
+
+const char* profile_phase_name(ProfilePhase phase) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects the wall time and byte count of each phase of a job.
+///
+/// \details Events may be recorded from any thread.
+class Profiler final {
+public:
+   using clock = std::chrono::steady_clock;
+
+   Profiler();
+
+   void record(ProfilePhase phase, S subject, clock::duration duration, U64 bytes);
+
+   void log_summary() const;
+   void write_json(std::ostream& os) const;
+
+private:
+   struct event_ {
+      ProfilePhase phase;
+      S subject;
+      clock::duration duration;
+      U64 bytes;
+   };
+   struct phase_total_ {
+      std::size_t count = 0;
+      clock::duration duration = clock::duration::zero();
+      U64 bytes = 0;
+   };
+   using totals_type = std::array<phase_total_, std::size_t(ProfilePhase::count)>;
+
+   totals_type totals_() const;
+
+   clock::time_point start_;
+   mutable std::mutex mutex_;
+   std::vector<event_> events_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the time between construction and destruction as one
+///         event, unless profiler is null.
+class ProfileScope final {
+public:
+   ProfileScope(Profiler* profiler, ProfilePhase phase, S subject = S());
+   ProfileScope(const ProfileScope&) = delete;
+   ProfileScope& operator=(const ProfileScope&) = delete;
+   ~ProfileScope();
+
+   void bytes(U64 bytes) noexcept;
+
+private:
+   Profiler* profiler_;
+   ProfilePhase phase_;
+   S subject_;
+   U64 bytes_ = 0;
+   Profiler::clock::time_point start_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The largest resident set size of this process so far, or 0 if it
+///         can't be determined.
+U64 peak_rss_bytes() noexcept;
+
+} // be::tools
+
+#endif
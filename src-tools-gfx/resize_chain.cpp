@@ -0,0 +1,46 @@
+#include "resize_chain.hpp"
+#include <algorithm>
+
+namespace be::tools {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+bool contains(ivec3 outer, ivec3 inner) {
+   return outer.x >= inner.x && outer.y >= inner.y && outer.z >= inner.z;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+ResizeChain::ResizeChain(MipmapImage source) {
+   levels_.push_back(std::move(source));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ivec3 ResizeChain::source_dim() const {
+   return levels_.front().dim();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MipmapImage ResizeChain::resize(ivec3 dim) {
+   for (;;) {
+      const ivec3 half_dim = glm::max(levels_.back().dim() / 2, ivec3(1));
+      if (half_dim == levels_.back().dim() || !contains(half_dim, dim)) {
+         break;
+      }
+      MipmapImage half(half_dim);
+      downsample_rows(levels_.back(), half, MipmapFilter::box, 0, half_dim.y, false);
+      levels_.push_back(std::move(half));
+   }
+
+   auto it = std::find_if(levels_.rbegin(), levels_.rend(), [=](const MipmapImage& level) {
+      return contains(level.dim(), dim);
+   });
+   const MipmapImage& level = it == levels_.rend() ? levels_.front() : *it;
+
+   MipmapImage result(dim);
+   downsample_rows(level, result, MipmapFilter::box, 0, dim.y, false);
+   return result;
+}
+
+} // be::tools
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_RESIZE_CHAIN_HPP_
+#define BE_TOOLS_GFX_RESIZE_CHAIN_HPP_
+
+#include "mipmap_filter.hpp"
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Produces any number of smaller copies of one source image.
+///
+/// \details The source is halved repeatedly with the box filter, and each
+///         halved level is kept, so each requested size is resampled from
+///         the smallest level that is at least as large as it, and no level
+///         is computed twice.  Not safe to use from multiple threads at once.
+class ResizeChain final {
+public:
+   explicit ResizeChain(MipmapImage source);
+
+   ivec3 source_dim() const;
+   MipmapImage resize(ivec3 dim);
+
+private:
+   std::vector<MipmapImage> levels_;
+};
+
+} // be::tools
+
+#endif
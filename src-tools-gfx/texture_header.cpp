@@ -0,0 +1,375 @@
+#include "texture_header.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace be::tools {
+namespace {
+
+using gfx::tex::Colorspace;
+using gfx::tex::FieldType;
+using gfx::tex::ImageFormat;
+using gfx::tex::TextureClass;
+using gfx::tex::TextureFileFormat;
+
+///////////////////////////////////////////////////////////////////////////////
+U32 read_le(const UC* ptr, std::size_t bytes) {
+   U32 value = 0;
+   for (std::size_t i = 0; i < bytes; ++i) {
+      value |= U32(ptr[i]) << (8 * i);
+   }
+   return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+U32 read_be(const UC* ptr, std::size_t bytes) {
+   U32 value = 0;
+   for (std::size_t i = 0; i < bytes; ++i) {
+      value = (value << 8) | U32(ptr[i]);
+   }
+   return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_bytes(std::istream& is, UC* dest, std::size_t size) {
+   is.read(reinterpret_cast<char*>(dest), size);
+   return std::size_t(is.gcount()) == size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TextureFileFormat detect_format(const UC* magic, std::size_t size) {
+   if (size >= 12 && std::memcmp(magic, "\xABKTX 11\xBB\r\n\x1A\n", 12) == 0) {
+      return TextureFileFormat::ktx;
+   } else if (size >= 8 && std::memcmp(magic, "\x89PNG\r\n\x1A\n", 8) == 0) {
+      return TextureFileFormat::png;
+   } else if (size >= 3 && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) {
+      return TextureFileFormat::jpeg;
+   } else if (size >= 2 && magic[0] == 'B' && magic[1] == 'M') {
+      return TextureFileFormat::bmp;
+   } else if (size >= 2 && magic[0] == '#' && magic[1] == '?') {
+      return TextureFileFormat::hdr;
+   }
+   return TextureFileFormat::unknown;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_ktx_header(std::istream& is, TextureHeader& header) {
+   UC data[64];
+   if (!read_bytes(is, data, sizeof(data))) {
+      return false;
+   }
+
+   U32 (*read)(const UC*, std::size_t) = read_le;
+   U32 endianness = read_le(data + 12, 4);
+   if (endianness == 0x01020304) {
+      read = read_be;
+   } else if (endianness != 0x04030201) {
+      return false;
+   }
+
+   U32 gl_type = read(data + 16, 4);
+   U32 gl_format = read(data + 24, 4);
+   U32 gl_internal_format = read(data + 28, 4);
+   U32 width = read(data + 36, 4);
+   U32 height = read(data + 40, 4);
+   U32 depth = read(data + 44, 4);
+   U32 layers = read(data + 48, 4);
+   U32 faces = read(data + 52, 4);
+   U32 levels = read(data + 56, 4);
+
+   if (width == 0 || (faces != 1 && faces != 6)) {
+      return false;
+   }
+
+   header.dim = ivec3(I32(width), I32(std::max(height, 1u)), I32(std::max(depth, 1u)));
+   header.layers = std::max(layers, 1u);
+   header.faces = faces;
+   header.levels = std::max(levels, 1u);
+
+   if (faces == 6) {
+      header.tex_class = layers > 0 ? TextureClass::directional_array : TextureClass::directional;
+   } else if (depth > 0) {
+      header.tex_class = layers > 0 ? TextureClass::volumetric_array : TextureClass::volumetric;
+   } else if (height > 0) {
+      header.tex_class = layers > 0 ? TextureClass::planar_array : TextureClass::planar;
+   } else {
+      header.tex_class = layers > 0 ? TextureClass::lineal_array : TextureClass::lineal;
+   }
+
+   // glFormat and glType are zero for compressed formats, so components and component_bits stay unknown.
+   switch (gl_format) {
+      case 0x1903: // GL_RED
+      case 0x1909: // GL_LUMINANCE
+         header.components = 1; break;
+      case 0x8227: // GL_RG
+      case 0x190A: // GL_LUMINANCE_ALPHA
+         header.components = 2; break;
+      case 0x1907: // GL_RGB
+      case 0x80E0: // GL_BGR
+         header.components = 3; break;
+      case 0x1908: // GL_RGBA
+      case 0x80E1: // GL_BGRA
+         header.components = 4; break;
+      default: break;
+   }
+
+   switch (gl_type) {
+      case 0x1400: case 0x1401: header.component_bits = 8; break;  // GL_BYTE, GL_UNSIGNED_BYTE
+      case 0x1402: case 0x1403: header.component_bits = 16; break; // GL_SHORT, GL_UNSIGNED_SHORT
+      case 0x1404: case 0x1405: header.component_bits = 32; break; // GL_INT, GL_UNSIGNED_INT
+      case 0x140B: header.component_bits = 16; header.floating_point = true; break; // GL_HALF_FLOAT
+      case 0x1406: header.component_bits = 32; header.floating_point = true; break; // GL_FLOAT
+      default: break;
+   }
+
+   // Compressed formats have no glType, so their size comes from the internal format; each is a 4x4 block.
+   switch (gl_internal_format) {
+      case 0x83F0: case 0x83F1: // GL_COMPRESSED_RGB(A)_S3TC_DXT1_EXT
+      case 0x8C4C: case 0x8C4D: // GL_COMPRESSED_SRGB(_ALPHA)_S3TC_DXT1_EXT
+      case 0x8DBB: case 0x8DBC: // GL_COMPRESSED_(SIGNED_)RED_RGTC1
+      case 0x8D64:              // GL_ETC1_RGB8_OES
+      case 0x9270: case 0x9271: // GL_COMPRESSED_(SIGNED_)R11_EAC
+      case 0x9274: case 0x9275: // GL_COMPRESSED_(S)RGB8_ETC2
+      case 0x9276: case 0x9277: // GL_COMPRESSED_(S)RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+         header.texel_bytes = 8 / 16.0; break;
+      case 0x83F2: case 0x83F3: // GL_COMPRESSED_RGBA_S3TC_DXT3/5_EXT
+      case 0x8C4E: case 0x8C4F: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3/5_EXT
+      case 0x8DBD: case 0x8DBE: // GL_COMPRESSED_(SIGNED_)RG_RGTC2
+      case 0x8E8C: case 0x8E8D: // GL_COMPRESSED_(SRGB_ALPHA|RGBA)_BPTC_UNORM
+      case 0x8E8E: case 0x8E8F: // GL_COMPRESSED_RGB_BPTC_(UN)SIGNED_FLOAT
+      case 0x9272: case 0x9273: // GL_COMPRESSED_(SIGNED_)RG11_EAC
+      case 0x9278: case 0x9279: // GL_COMPRESSED_(SRGB8_ALPHA8|RGBA8)_ETC2_EAC
+         header.texel_bytes = 16 / 16.0; break;
+      default: break;
+   }
+
+   switch (gl_internal_format) {
+      case 0x8C41: // GL_SRGB8
+      case 0x8C43: // GL_SRGB8_ALPHA8
+      case 0x8C4C: // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+      case 0x8C4D: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+      case 0x8C4E: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT
+      case 0x8C4F: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+      case 0x8E8D: // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+      case 0x9275: // GL_COMPRESSED_SRGB8_ETC2
+      case 0x9277: // GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2
+      case 0x9279: // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+         header.colorspace = Colorspace::srgb; break;
+      default:
+         header.colorspace = header.floating_point ? Colorspace::linear_other : Colorspace::unknown; break;
+   }
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_png_header(std::istream& is, TextureHeader& header) {
+   UC data[26];
+   if (!read_bytes(is, data, sizeof(data)) || std::memcmp(data + 12, "IHDR", 4) != 0) {
+      return false;
+   }
+   header.dim = ivec3(I32(read_be(data + 16, 4)), I32(read_be(data + 20, 4)), 1);
+
+   // Palettes are expanded and bit depths below 8 are widened when decoding.
+   const U8 depth = data[24];
+   switch (data[25]) {
+      case 0: header.components = 1; break;
+      case 2: header.components = 3; break;
+      case 3: header.components = 4; break;
+      case 4: header.components = 2; break;
+      case 6: header.components = 4; break;
+      default: return false;
+   }
+   header.component_bits = depth == 16 ? 16 : 8;
+   header.colorspace = Colorspace::srgb;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_jpeg_header(std::istream& is, TextureHeader& header) {
+   UC data[8];
+   if (!read_bytes(is, data, 2)) {
+      return false;
+   }
+
+   for (;;) {
+      if (!read_bytes(is, data, 2) || data[0] != 0xFF) {
+         return false;
+      }
+
+      UC marker = data[1];
+      while (marker == 0xFF) {
+         if (!read_bytes(is, &marker, 1)) {
+            return false;
+         }
+      }
+
+      if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+         continue;
+      } else if (marker == 0xD9 || marker == 0xDA) {
+         return false;
+      }
+
+      if (!read_bytes(is, data, 2)) {
+         return false;
+      }
+      U32 length = read_be(data, 2);
+      if (length < 2) {
+         return false;
+      }
+
+      bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+      if (sof) {
+         if (length < 8 || !read_bytes(is, data, 6)) {
+            return false;
+         }
+         header.dim = ivec3(I32(read_be(data + 3, 2)), I32(read_be(data + 1, 2)), 1);
+         header.components = data[5] == 1 ? 1 : 3;
+         header.component_bits = 8;
+         header.colorspace = Colorspace::srgb;
+         return true;
+      }
+
+      is.seekg(length - 2, std::ios::cur);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_tga_header(std::istream& is, TextureHeader& header) {
+   UC data[18];
+   if (!read_bytes(is, data, sizeof(data))) {
+      return false;
+   }
+   header.dim = ivec3(I32(read_le(data + 12, 2)), I32(read_le(data + 14, 2)), 1);
+
+   const U8 image_type = data[2] & 7;
+   const U8 pixel_bits = data[16];
+   if (image_type == 3) {
+      header.components = pixel_bits == 16 ? 2 : 1;
+   } else if (image_type == 1) {
+      header.components = data[7] == 32 ? 4 : 3; // color map entry size
+   } else {
+      header.components = pixel_bits == 32 ? 4 : 3;
+   }
+   header.component_bits = 8;
+   header.colorspace = Colorspace::srgb;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_bmp_header(std::istream& is, TextureHeader& header) {
+   UC data[30];
+   if (!read_bytes(is, data, sizeof(data))) {
+      return false;
+   }
+
+   U32 dib_size = read_le(data + 14, 4);
+   U32 pixel_bits;
+   if (dib_size == 12) {
+      header.dim = ivec3(I32(read_le(data + 18, 2)), I32(read_le(data + 20, 2)), 1);
+      pixel_bits = read_le(data + 24, 2);
+   } else {
+      I32 width = I32(read_le(data + 18, 4));
+      I32 height = I32(read_le(data + 22, 4));
+      header.dim = ivec3(width, height < 0 ? -height : height, 1);
+      pixel_bits = read_le(data + 28, 2);
+   }
+
+   header.components = pixel_bits == 32 ? 4 : 3;
+   header.component_bits = 8;
+   header.colorspace = Colorspace::srgb;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool read_hdr_header(std::istream& is, TextureHeader& header) {
+   S line;
+   if (!std::getline(is, line) || (line != "#?RADIANCE" && line != "#?RGBE")) {
+      return false;
+   }
+
+   while (std::getline(is, line) && !line.empty()) { }
+
+   if (!std::getline(is, line)) {
+      return false;
+   }
+
+   char y_axis[3] = { };
+   char x_axis[3] = { };
+   int height = 0;
+   int width = 0;
+   if (std::sscanf(line.c_str(), "%2s %d %2s %d", y_axis, &height, x_axis, &width) != 4 || y_axis[1] != 'Y' || x_axis[1] != 'X') {
+      return false;
+   }
+
+   header.dim = ivec3(width, height, 1);
+   header.components = 3;
+   header.component_bits = 32;
+   header.floating_point = true;
+   header.colorspace = Colorspace::linear_other;
+   return true;
+}
+
+} // be::tools::()
+
+///////////////////////////////////////////////////////////////////////////////
+TextureHeader read_texture_header(const Path& path, TextureFileFormat format, std::error_code& ec) {
+   TextureHeader header;
+
+   std::ifstream is(path.string(), std::ios::binary);
+   if (!is) {
+      ec = std::make_error_code(std::errc::no_such_file_or_directory);
+      return header;
+   }
+
+   UC magic[12];
+   is.read(reinterpret_cast<char*>(magic), sizeof(magic));
+   std::size_t magic_size = std::size_t(is.gcount());
+   is.clear();
+   is.seekg(0);
+
+   TextureFileFormat detected = detect_format(magic, magic_size);
+   if (detected != TextureFileFormat::unknown) {
+      format = detected;
+   }
+
+   bool ok = false;
+   switch (format) {
+      case TextureFileFormat::ktx:  ok = read_ktx_header(is, header); break;
+      case TextureFileFormat::png:  ok = read_png_header(is, header); break;
+      case TextureFileFormat::jpeg: ok = read_jpeg_header(is, header); break;
+      case TextureFileFormat::tga:  ok = read_tga_header(is, header); break;
+      case TextureFileFormat::bmp:  ok = read_bmp_header(is, header); break;
+      case TextureFileFormat::hdr:  ok = read_hdr_header(is, header); break;
+      default:
+         ec = std::make_error_code(std::errc::not_supported);
+         return header;
+   }
+
+   if (!ok || header.dim.x <= 0 || header.dim.y <= 0) {
+      ec = std::make_error_code(std::errc::illegal_byte_sequence);
+      return header;
+   }
+
+   if (header.texel_bytes == 0) {
+      header.texel_bytes = header.components * header.component_bits / 8.0;
+   }
+
+   header.file_format = format;
+   return header;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void set_header_format(const ImageFormat& format, TextureHeader& header) {
+   const ImageFormat::block_dim_type block_dim = format.block_dim();
+   const std::size_t block_texels = std::size_t(block_dim.x) * block_dim.y * block_dim.z;
+   const FieldType field_type = format.field_type(0);
+
+   header.components = format.components();
+   header.component_bits = block_texels == 1 && header.components > 0 ? U8(format.block_size() * 8u / header.components) : 0;
+   header.floating_point = field_type == FieldType::ufloat || field_type == FieldType::sfloat || field_type == FieldType::expo;
+   header.texel_bytes = block_texels > 0 ? double(format.block_size()) / block_texels : 0;
+   header.colorspace = format.colorspace();
+}
+
+} // be::tools
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_TEXTURE_HEADER_HPP_
+#define BE_TOOLS_GFX_TEXTURE_HEADER_HPP_
+
+#include <be/core/filesystem.hpp>
+#include <be/core/glm.hpp>
+#include <be/gfx/tex/texture.hpp>
+#include <be/gfx/tex/texture_file_format.hpp>
+#include <system_error>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The layout of a texture file, as described by its header.
+///
+/// \details components and component_bits describe the texels the file's
+///         reader will produce; they are zero if the header doesn't say (eg.
+///         block compressed KTX files).  texel_bytes is the average size of a
+///         texel as stored, including block compressed formats, or zero if it
+///         isn't known.
+struct TextureHeader {
+   gfx::tex::TextureFileFormat file_format = gfx::tex::TextureFileFormat::unknown;
+   gfx::tex::TextureClass tex_class = gfx::tex::TextureClass::planar;
+   ivec3 dim = ivec3(1);
+   std::size_t layers = 1;
+   std::size_t faces = 1;
+   std::size_t levels = 1;
+   U8 components = 0;
+   U8 component_bits = 0;
+   bool floating_point = false;
+   double texel_bytes = 0;
+   gfx::tex::Colorspace colorspace = gfx::tex::Colorspace::unknown;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fills in the texel format fields of header from the format of a
+///         decoded texture, for files whose header couldn't be read.
+void set_header_format(const gfx::tex::ImageFormat& format, TextureHeader& header);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads only the header of a texture or image file to determine its
+///         dimensions, layer/face/level counts, and texel format, without
+///         decoding the payload.
+///
+/// \details Supports KTX, PNG, JPEG, Targa, DIB, and Radiance RGBE files.  For
+///         other formats (including beTx) ec is set to
+///         std::errc::not_supported and the file must be decoded to find its
+///         layout.
+TextureHeader read_texture_header(const Path& path, gfx::tex::TextureFileFormat format, std::error_code& ec);
+
+} // be::tools
+
+#endif
@@ -0,0 +1,129 @@
+#include "texture_io.hpp"
+#include <be/gfx/tex/texture_reader.hpp>
+#include <fstream>
+
+namespace be::tools {
+namespace {
+
+using namespace gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+void parse_texture(TextureReader& reader, const Path& path, Profiler* profiler, DecodedTexture& result) {
+   ProfileScope scope(profiler, ProfilePhase::parse, path.string());
+   result.texture = reader.texture(result.parse_error);
+   result.file_format = reader.format();
+   if (result.texture.storage) {
+      scope.bytes(result.texture.storage->size());
+   }
+}
+
+} // be::tools::()
+
+using namespace gfx::tex;
+
+///////////////////////////////////////////////////////////////////////////////
+FileStamp file_stamp(const Path& path) {
+   FileStamp stamp;
+   std::error_code ec;
+   stamp.size = fs::file_size(path, ec);
+   if (!ec) {
+      stamp.mtime = fs::last_write_time(path, ec);
+   }
+   stamp.valid = !ec;
+   return stamp;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FileContents read_file_contents(const Path& path, Profiler* profiler) {
+   FileContents result;
+   result.stamp = file_stamp(path);
+
+   ProfileScope scope(profiler, ProfilePhase::read, path.string());
+   std::ifstream is(path.string(), std::ios::binary | std::ios::ate);
+   const std::streamoff size = is ? std::streamoff(is.tellg()) : std::streamoff(-1);
+   if (size <= 0) {
+      result.error = std::make_error_code(is ? std::errc::invalid_argument : std::errc::no_such_file_or_directory);
+      return result;
+   }
+
+   auto buffer = std::make_shared<std::vector<UC>>(std::size_t(size));
+   UC* data = buffer->data();
+   result.buffer = std::move(buffer);
+
+   is.seekg(0);
+   is.read(reinterpret_cast<char*>(data), size);
+   if (is.gcount() != size) {
+      result.error = std::make_error_code(std::errc::io_error);
+      result.buffer.reset();
+      return result;
+   }
+
+   result.data = data;
+   result.size = std::size_t(size);
+   scope.bytes(U64(size));
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+DecodedTexture decode_file_contents(const Path& path, TextureFileFormat format, FileContents contents, Profiler* profiler) {
+   DecodedTexture result;
+   if (contents.error) {
+      result.read_error = contents.error;
+      return result;
+   }
+
+   TextureReader reader;
+   if (format != TextureFileFormat::unknown) {
+      reader.reset(format);
+   }
+
+   result.contents = std::move(contents.buffer);
+   reader.read(tmp_buf(contents.data, contents.size), result.read_error);
+   if (!result.read_error) {
+      parse_texture(reader, path, profiler, result);
+   }
+
+   return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+DecodedTexture read_texture_file(const Path& path, TextureFileFormat format, bool use_mmap, Profiler* profiler) {
+   std::shared_ptr<MappedFile> mapping;
+   if (use_mmap) {
+      std::error_code ec;
+      mapping = std::make_shared<MappedFile>(path, ec);
+      if (ec) {
+         mapping.reset();
+      }
+   }
+
+   DecodedTexture result;
+   result.mapping = std::move(mapping);
+
+   TextureReader reader;
+   if (format != TextureFileFormat::unknown) {
+      reader.reset(format);
+   }
+
+   {
+      ProfileScope scope(profiler, ProfilePhase::read, path.string());
+      if (result.mapping) {
+         reader.read(tmp_buf(result.mapping->data(), result.mapping->size()), result.read_error);
+         scope.bytes(result.mapping->size());
+      } else {
+         reader.read(path, result.read_error);
+         if (profiler) {
+            std::error_code ec;
+            const auto size = fs::file_size(path, ec);
+            scope.bytes(ec ? 0 : U64(size));
+         }
+      }
+   }
+   if (!result.read_error) {
+      parse_texture(reader, path, profiler, result);
+   }
+
+   return result;
+}
+
+} // be::tools
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_TEXTURE_IO_HPP_
+#define BE_TOOLS_GFX_TEXTURE_IO_HPP_
+
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+#include <be/gfx/tex/texture.hpp>
+#include <be/gfx/tex/texture_file_format.hpp>
+#include <be/core/filesystem.hpp>
+#include <memory>
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A texture file read and parsed by read_texture_file.
+///
+/// \details If the file was memory mapped, the texture's storage may refer to
+///         the mapping, so it must be kept alive as long as the texture.
+///         Likewise, contents must be kept alive if it was set.  Textures from a DecodeCache have no
+///         texture.storage; their view refers to shared_storage instead, which
+///         must not be modified.
+struct DecodedTexture {
+   gfx::tex::TextureFileFormat file_format = gfx::tex::TextureFileFormat::unknown;
+   std::shared_ptr<MappedFile> mapping;
+   std::shared_ptr<const std::vector<UC>> contents;
+   std::shared_ptr<gfx::tex::TextureStorage> shared_storage;
+   bool cache_hit = false;
+   gfx::tex::Texture texture;
+   std::error_code read_error;
+   std::error_code parse_error;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The size and modification time of a file, used to detect when a
+///         file has changed since it was read.
+struct FileStamp {
+   std::uintmax_t size = 0;
+   fs::file_time_type mtime;
+   bool valid = false;
+};
+
+FileStamp file_stamp(const Path& path);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The raw contents of a file, read by read_file_contents.
+///
+/// \details stamp is taken before the file is read, so if the file changes
+///         while it's being read, the stamp is out of date rather than the
+///         contents being newer than it claims.
+struct FileContents {
+   const UC* data = nullptr;
+   std::size_t size = 0;
+   std::shared_ptr<const std::vector<UC>> buffer; // owns data
+   FileStamp stamp;
+   std::error_code error;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads an entire file into memory.
+///
+/// \details Doesn't log or throw for read errors, so it may be called from
+///         any thread.  The read time is recorded if profiler is not null.
+FileContents read_file_contents(const Path& path, Profiler* profiler);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses a texture or image file which has already been read into
+///         memory by read_file_contents.
+///
+/// \details Like read_texture_file, but without any file access, so reads can
+///         be issued separately from decoding.
+DecodedTexture decode_file_contents(const Path& path, gfx::tex::TextureFileFormat format, FileContents contents, Profiler* profiler);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads and parses a texture or image file with TextureReader.
+///
+/// \details If format is unknown, it is detected from the file.  Doesn't log
+///         or throw for read or parse errors, so it may be called from worker
+///         threads; read and parse times are recorded if profiler is not
+///         null.
+DecodedTexture read_texture_file(const Path& path, gfx::tex::TextureFileFormat format, bool use_mmap, Profiler* profiler);
+
+} // be::tools
+
+#endif
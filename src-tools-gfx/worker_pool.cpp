@@ -0,0 +1,58 @@
+#include "worker_pool.hpp"
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::WorkerPool(std::size_t threads) {
+   if (threads > 1) {
+      threads_.reserve(threads);
+      for (std::size_t i = 0; i < threads; ++i) {
+         threads_.emplace_back([this]() { run_(); });
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::~WorkerPool() {
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+   }
+   cv_.notify_all();
+   for (std::thread& thread : threads_) {
+      thread.join();
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+std::size_t WorkerPool::size() const noexcept {
+   return threads_.empty() ? 1 : threads_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::enqueue_(std::function<void()> task) {
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+   }
+   cv_.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::run_() {
+   for (;;) {
+      std::function<void()> task;
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         cv_.wait(lock, [this]() { return shutdown_ || !tasks_.empty(); });
+         if (tasks_.empty()) {
+            return;
+         }
+         task = std::move(tasks_.front());
+         tasks_.pop_front();
+      }
+      task();
+   }
+}
+
+} // be::tools
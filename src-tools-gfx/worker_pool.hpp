@@ -0,0 +1,62 @@
+#pragma once
+#ifndef BE_TOOLS_GFX_WORKER_POOL_HPP_
+#define BE_TOOLS_GFX_WORKER_POOL_HPP_
+
+#include <be/core/be.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace be::tools {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A fixed set of worker threads which run submitted tasks in FIFO
+///         order.
+///
+/// \details If the pool is created with fewer than 2 threads, no threads are
+///         started and tasks are run immediately on the submitting thread.
+class WorkerPool final {
+public:
+   explicit WorkerPool(std::size_t threads);
+   WorkerPool(const WorkerPool&) = delete;
+   WorkerPool& operator=(const WorkerPool&) = delete;
+   ~WorkerPool();
+
+   std::size_t size() const noexcept;
+
+   template <typename F>
+   std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& func);
+
+private:
+   void enqueue_(std::function<void()> task);
+   void run_();
+
+   std::vector<std::thread> threads_;
+   std::deque<std::function<void()>> tasks_;
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   bool shutdown_ = false;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+template <typename F>
+std::future<std::invoke_result_t<std::decay_t<F>>> WorkerPool::submit(F&& func) {
+   using result_type = std::invoke_result_t<std::decay_t<F>>;
+   auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(func));
+   std::future<result_type> result = task->get_future();
+   if (threads_.empty()) {
+      (*task)();
+   } else {
+      enqueue_([task]() { (*task)(); });
+   }
+   return result;
+}
+
+} // be::tools
+
+#endif